@@ -0,0 +1,138 @@
+#include "atomic-bitset.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+
+namespace {
+constexpr bitset_utils::word_type max_bit = 1ULL << (bitset_utils::word_size - 1);
+
+bitset_utils::word_type bit(std::size_t pos) {
+  return max_bit >> bitset_utils::offset(pos);
+}
+} // namespace
+
+atomic_bitset::atomic_bitset(std::size_t size)
+    : _size(size)
+    , _data(size > 0 ? new word_type[word_cnt()]() : nullptr) {}
+
+atomic_bitset::atomic_bitset(std::size_t size, bool value)
+    : atomic_bitset(size) {
+  if (value) {
+    for (std::size_t i = 0; i < word_cnt(); ++i) {
+      _data[i] = valid_mask(i);
+    }
+  }
+}
+
+atomic_bitset::~atomic_bitset() {
+  delete[] _data;
+}
+
+std::size_t atomic_bitset::size() const {
+  return _size;
+}
+
+std::size_t atomic_bitset::word_cnt() const {
+  return size() / bitset_utils::word_size + (size() % bitset_utils::word_size > 0);
+}
+
+bool atomic_bitset::empty() const {
+  return size() == 0;
+}
+
+bool atomic_bitset::test(std::size_t pos, std::memory_order order) const {
+  return word(bitset_utils::word_ind(pos)).load(order) & bit(pos);
+}
+
+bool atomic_bitset::test_and_set(std::size_t pos, std::memory_order order) {
+  return word(bitset_utils::word_ind(pos)).fetch_or(bit(pos), order) & bit(pos);
+}
+
+bool atomic_bitset::test_and_reset(std::size_t pos, std::memory_order order) {
+  return word(bitset_utils::word_ind(pos)).fetch_and(~bit(pos), order) & bit(pos);
+}
+
+bool atomic_bitset::test_and_flip(std::size_t pos, std::memory_order order) {
+  return word(bitset_utils::word_ind(pos)).fetch_xor(bit(pos), order) & bit(pos);
+}
+
+atomic_bitset::word_type atomic_bitset::fetch_or_word(std::size_t ind, word_type w, std::memory_order order) {
+  return word(ind).fetch_or(w & valid_mask(ind), order);
+}
+
+atomic_bitset::word_type atomic_bitset::fetch_and_word(std::size_t ind, word_type w, std::memory_order order) {
+  return word(ind).fetch_and(w | ~valid_mask(ind), order);
+}
+
+atomic_bitset::word_type atomic_bitset::fetch_xor_word(std::size_t ind, word_type w, std::memory_order order) {
+  return word(ind).fetch_xor(w & valid_mask(ind), order);
+}
+
+atomic_bitset::word_type atomic_bitset::load_word(std::size_t ind, std::memory_order order) const {
+  return word(ind).load(order);
+}
+
+std::size_t atomic_bitset::find_and_set_first_zero(std::memory_order order) {
+  for (std::size_t i = 0; i < word_cnt(); ++i) {
+    std::atomic_ref<word_type> w = word(i);
+    word_type cur = w.load(std::memory_order_relaxed);
+    word_type free = ~cur & valid_mask(i);
+    while (free != 0) {
+      word_type claim = max_bit >> std::countl_zero(free);
+      if (w.compare_exchange_weak(cur, cur | claim, order, std::memory_order_relaxed)) {
+        return i * bitset_utils::word_size + std::countl_zero(free);
+      }
+      free = ~cur & valid_mask(i);
+    }
+  }
+  return npos;
+}
+
+std::size_t atomic_bitset::count() const {
+  std::size_t res = 0;
+  for (std::size_t i = 0; i < word_cnt(); ++i) {
+    res += std::popcount(word(i).load(std::memory_order_relaxed));
+  }
+  return res;
+}
+
+bool atomic_bitset::any() const {
+  for (std::size_t i = 0; i < word_cnt(); ++i) {
+    if (word(i).load(std::memory_order_relaxed)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool atomic_bitset::all() const {
+  for (std::size_t i = 0; i < word_cnt(); ++i) {
+    if (word(i).load(std::memory_order_relaxed) != valid_mask(i)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bitset atomic_bitset::snapshot() const {
+  bitset res(size());
+  for (std::size_t i = 0; i < word_cnt(); ++i) {
+    res.data()[i] = word(i).load(std::memory_order_relaxed);
+  }
+  return res;
+}
+
+atomic_bitset::operator const_view() const {
+  return {0, _size, _data};
+}
+
+std::atomic_ref<atomic_bitset::word_type> atomic_bitset::word(std::size_t ind) const {
+  return std::atomic_ref<word_type>(_data[ind]);
+}
+
+atomic_bitset::word_type atomic_bitset::valid_mask(std::size_t ind) const {
+  std::size_t bits = std::min(bitset_utils::word_size, size() - ind * bitset_utils::word_size);
+  return bitset_utils::mask << (bitset_utils::word_size - bits);
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "bitset-utils.h"
+#include "bitset.h"
+
+#include <atomic>
+#include <cstddef>
+
+// Fixed-size bitset with lock-free concurrent updates. Words use the bitset layout and are accessed
+// through std::atomic_ref, so the storage can also be read as a const_view. Bits past size() are
+// always 0.
+class atomic_bitset {
+public:
+  using word_type = bitset_utils::word_type;
+  using const_view = bitset::const_view;
+
+  static constexpr std::size_t npos = bitset_utils::npos;
+
+  explicit atomic_bitset(std::size_t size);
+  atomic_bitset(std::size_t size, bool value);
+
+  atomic_bitset(const atomic_bitset& other) = delete;
+  atomic_bitset& operator=(const atomic_bitset& other) = delete;
+
+  ~atomic_bitset();
+
+  std::size_t size() const;
+  std::size_t word_cnt() const;
+  bool empty() const;
+
+  bool test(std::size_t pos, std::memory_order order = std::memory_order_seq_cst) const;
+
+  // Return the previous value of the bit
+  bool test_and_set(std::size_t pos, std::memory_order order = std::memory_order_seq_cst);
+  bool test_and_reset(std::size_t pos, std::memory_order order = std::memory_order_seq_cst);
+  bool test_and_flip(std::size_t pos, std::memory_order order = std::memory_order_seq_cst);
+
+  // Word-level read-modify-write, bits of word past size() are ignored. Return the previous word.
+  word_type fetch_or_word(std::size_t ind, word_type word, std::memory_order order = std::memory_order_seq_cst);
+  word_type fetch_and_word(std::size_t ind, word_type word, std::memory_order order = std::memory_order_seq_cst);
+  word_type fetch_xor_word(std::size_t ind, word_type word, std::memory_order order = std::memory_order_seq_cst);
+  word_type load_word(std::size_t ind, std::memory_order order = std::memory_order_seq_cst) const;
+
+  // Atomically claims the first zero bit and returns its position, npos if all bits are set
+  std::size_t find_and_set_first_zero(std::memory_order order = std::memory_order_seq_cst);
+
+  // Bulk reads load every word with relaxed ordering: each word is read atomically, but the result
+  // is not a consistent snapshot while writers are running
+  std::size_t count() const;
+  bool any() const;
+  bool all() const;
+  bitset snapshot() const;
+
+  // Plain view of the storage, only valid to read while no writer is running
+  operator const_view() const;
+
+private:
+  std::size_t _size;
+  word_type* _data;
+
+  std::atomic_ref<word_type> word(std::size_t ind) const;
+  word_type valid_mask(std::size_t ind) const;
+};
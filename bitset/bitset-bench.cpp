@@ -0,0 +1,191 @@
+// Benchmarks for bitset and its views. There is no build system here, build it next to the sources:
+//   g++ -std=c++20 -O2 -march=native -DNDEBUG bitset-bench.cpp bitset.cpp bitset-simd.cpp bitset-format.cpp
+// Usage: ./a.out [filter] [max_bits]. Runs every benchmark whose name contains filter for sizes
+// from 64 bits to max_bits (1 Gbit by default) and prints time per iteration and bytes per cycle.
+// Cycles are TSC ticks, so they follow the nominal frequency rather than the current one.
+
+#include "bitset.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BITSET_BENCH_CYCLES 1
+#endif
+
+namespace {
+using clock_type = std::chrono::steady_clock;
+
+constexpr std::size_t default_max_bits = std::size_t(1) << 30;
+// Per-bit benchmarks stop here, larger sizes take seconds per iteration
+constexpr std::size_t per_bit_max_bits = std::size_t(1) << 26;
+constexpr auto min_time = std::chrono::milliseconds(100);
+
+template <typename T>
+void do_not_optimize(const T& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+std::uint64_t cycles() {
+#ifdef BITSET_BENCH_CYCLES
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+bitset random_bitset(std::size_t bits, std::uint64_t seed) {
+  std::mt19937_64 rng(seed);
+  bitset res(bits);
+  for (std::size_t i = 0; i < res.word_cnt(); ++i) {
+    res.data()[i] = rng();
+  }
+  return res;
+}
+
+struct result {
+  double ns;
+  double cycles;
+};
+
+// Repeats f until min_time passes, doubling the iteration count, and reports the last round
+result measure(const std::function<void()>& f) {
+  for (std::size_t iterations = 1;; iterations *= 2) {
+    auto start = clock_type::now();
+    std::uint64_t start_cycles = cycles();
+    for (std::size_t i = 0; i < iterations; ++i) {
+      f();
+    }
+    std::uint64_t spent_cycles = cycles() - start_cycles;
+    auto spent = clock_type::now() - start;
+    if (spent >= min_time || iterations >= (std::size_t(1) << 30)) {
+      double ns = std::chrono::duration<double, std::nano>(spent).count();
+      return {ns / iterations, static_cast<double>(spent_cycles) / iterations};
+    }
+  }
+}
+
+struct benchmark {
+  const char* name;
+  std::size_t max_bits;
+  // Sets up the data for the size and returns one iteration with the number of bytes it processes
+  std::function<std::pair<std::function<void()>, std::size_t>(std::size_t)> setup;
+};
+
+std::vector<benchmark> benchmarks() {
+  std::vector<benchmark> res;
+
+  res.push_back({"and_assign/aligned", default_max_bits, [](std::size_t bits) {
+                   auto a = std::make_shared<bitset>(random_bitset(bits, 1));
+                   auto b = std::make_shared<bitset>(random_bitset(bits, 2));
+                   return std::make_pair(std::function<void()>([=] { *a &= *b; }), 2 * bits / 8);
+                 }});
+  // Same bit offset in both views, so the word fast path applies
+  res.push_back({"and_assign/subview_same_offset", default_max_bits, [](std::size_t bits) {
+                   auto a = std::make_shared<bitset>(random_bitset(bits + 64, 1));
+                   auto b = std::make_shared<bitset>(random_bitset(bits + 64, 2));
+                   return std::make_pair(std::function<void()>([=] { a->subview(3, bits) &= b->subview(3, bits); }),
+                                         2 * bits / 8);
+                 }});
+  res.push_back({"and_assign/subview_unaligned", default_max_bits, [](std::size_t bits) {
+                   auto a = std::make_shared<bitset>(random_bitset(bits + 64, 1));
+                   auto b = std::make_shared<bitset>(random_bitset(bits + 64, 2));
+                   return std::make_pair(std::function<void()>([=] { a->subview(3, bits) &= b->subview(5, bits); }),
+                                         2 * bits / 8);
+                 }});
+  res.push_back({"count/aligned", default_max_bits, [](std::size_t bits) {
+                   auto a = std::make_shared<bitset>(random_bitset(bits, 1));
+                   return std::make_pair(std::function<void()>([=] { do_not_optimize(a->count()); }), bits / 8);
+                 }});
+  res.push_back({"count/subview_unaligned", default_max_bits, [](std::size_t bits) {
+                   auto a = std::make_shared<bitset>(random_bitset(bits + 64, 1));
+                   return std::make_pair(std::function<void()>([=] { do_not_optimize(a->subview(5, bits).count()); }),
+                                         bits / 8);
+                 }});
+  res.push_back({"equal/aligned", default_max_bits, [](std::size_t bits) {
+                   auto a = std::make_shared<bitset>(random_bitset(bits, 1));
+                   auto b = std::make_shared<bitset>(*a);
+                   return std::make_pair(std::function<void()>([=] { do_not_optimize(*a == *b); }), 2 * bits / 8);
+                 }});
+  res.push_back({"equal/subview_unaligned", default_max_bits, [](std::size_t bits) {
+                   auto a = std::make_shared<bitset>(random_bitset(bits + 64, 1));
+                   auto b = std::make_shared<bitset>(a->subview(2));
+                   return std::make_pair(
+                       std::function<void()>([=] { do_not_optimize(a->subview(3, bits) == b->subview(1, bits)); }),
+                       2 * bits / 8);
+                 }});
+  res.push_back({"shift_left/3", default_max_bits, [](std::size_t bits) {
+                   auto a = std::make_shared<bitset>(random_bitset(bits, 1));
+                   return std::make_pair(std::function<void()>([=] { a->shift_left(3); }), bits / 8);
+                 }});
+  res.push_back({"rotate_left/67", default_max_bits, [](std::size_t bits) {
+                   auto a = std::make_shared<bitset>(random_bitset(bits, 1));
+                   return std::make_pair(std::function<void()>([=] { a->rotate_left(67); }), bits / 8);
+                 }});
+  res.push_back({"iterate/bits", per_bit_max_bits, [](std::size_t bits) {
+                   auto a = std::make_shared<bitset>(random_bitset(bits, 1));
+                   return std::make_pair(std::function<void()>([=] {
+                                           const bitset& c = *a;
+                                           std::size_t n = std::count(c.begin(), c.end(), true);
+                                           do_not_optimize(n);
+                                         }),
+                                         bits / 8);
+                 }});
+  res.push_back({"iterate/ones", default_max_bits, [](std::size_t bits) {
+                   auto a = std::make_shared<bitset>(random_bitset(bits, 1));
+                   return std::make_pair(std::function<void()>([=] {
+                                           std::size_t sum = 0;
+                                           for (std::size_t i : ones(*a)) {
+                                             sum += i;
+                                           }
+                                           do_not_optimize(sum);
+                                         }),
+                                         bits / 8);
+                 }});
+  res.push_back({"to_string", per_bit_max_bits, [](std::size_t bits) {
+                   auto a = std::make_shared<bitset>(random_bitset(bits, 1));
+                   return std::make_pair(std::function<void()>([=] { do_not_optimize(to_string(*a).size()); }),
+                                         bits / 8);
+                 }});
+  res.push_back({"parse", per_bit_max_bits, [](std::size_t bits) {
+                   auto str = std::make_shared<std::string>(to_string(random_bitset(bits, 1)));
+                   return std::make_pair(std::function<void()>([=] { do_not_optimize(bitset(*str).size()); }),
+                                         bits / 8);
+                 }});
+  res.push_back({"to_hex", per_bit_max_bits, [](std::size_t bits) {
+                   auto a = std::make_shared<bitset>(random_bitset(bits, 1));
+                   return std::make_pair(std::function<void()>([=] { do_not_optimize(to_hex(*a).size()); }), bits / 8);
+                 }});
+  return res;
+}
+} // namespace
+
+int main(int argc, char** argv) {
+  std::string_view filter = argc > 1 ? argv[1] : "";
+  std::size_t max_bits = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : default_max_bits;
+
+  std::printf("%-34s %12s %14s %12s\n", "benchmark", "bits", "ns/iter", "bytes/cycle");
+  for (const benchmark& b : benchmarks()) {
+    if (std::string_view(b.name).find(filter) == std::string_view::npos) {
+      continue;
+    }
+    for (std::size_t bits = 64; bits <= std::min(max_bits, b.max_bits); bits *= 8) {
+      auto [f, bytes] = b.setup(bits);
+      result r = measure(f);
+      double per_cycle = r.cycles > 0 ? bytes / r.cycles : 0;
+      std::printf("%-34s %12zu %14.1f %12.3f\n", b.name, bits, r.ns, per_cycle);
+    }
+  }
+}
@@ -0,0 +1,351 @@
+#pragma once
+
+#include "bitset-format.h"
+#include "bitset-utils.h"
+#include "bitset-view.h"
+
+#include <algorithm>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <type_traits>
+#include <utility>
+
+// Lazy bitwise expressions over bitset views. An expression only stores views of its operands and
+// produces the result word by word, so `a & b | ~c` is evaluated in a single pass straight into the
+// destination bitset or into a reduction such as count(). Like any view, an expression must not
+// outlive the bitsets it refers to.
+namespace bitset_expr {
+using word_type = bitset_utils::word_type;
+using const_view = bitset_view<const word_type>;
+
+// Which words of its operands word(i) reads, relative to i. It decides the order in which an
+// expression is evaluated into a destination it may alias.
+enum class reach { same, ahead, behind, both };
+
+constexpr reach combine(reach a, reach b) {
+  if (a == reach::same || a == b) {
+    return b;
+  }
+  return b == reach::same ? a : reach::both;
+}
+
+template <typename Derived>
+class expression {
+public:
+  std::size_t words_count() const {
+    return bitset_utils::word_ind(self().size()) + (bitset_utils::offset(self().size()) > 0);
+  }
+
+  bool empty() const {
+    return self().size() == 0;
+  }
+
+  // Bits of word(i) past size() are unspecified, this one clears them
+  word_type masked_word(std::size_t i) const {
+    word_type w = self().word(i);
+    std::size_t tail = bitset_utils::offset(self().size());
+    if (tail > 0 && i + 1 == words_count()) {
+      w &= bitset_utils::mask << (bitset_utils::word_size - tail);
+    }
+    return w;
+  }
+
+  std::size_t count() const {
+    std::size_t res = 0;
+    for (std::size_t i = 0; i < words_count(); ++i) {
+      res += std::popcount(masked_word(i));
+    }
+    return res;
+  }
+
+  bool any() const {
+    for (std::size_t i = 0; i < words_count(); ++i) {
+      if (masked_word(i)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool all() const {
+    std::size_t n = words_count();
+    for (std::size_t i = 0; i + 1 < n; ++i) {
+      if (self().word(i) != bitset_utils::mask) {
+        return false;
+      }
+    }
+    return n == 0 || (~self().word(n - 1) & (bitset_utils::mask << (bitset_utils::word_size * n - self().size()))) == 0;
+  }
+
+  // dst[i] = f(dst[i], word(i)) for every word, the tail word of the result is masked. dst may be the
+  // storage of one of the operands.
+  template <typename F>
+  void evaluate(word_type* dst, F f) const {
+    std::size_t n = words_count();
+    if (n == 0) {
+      return;
+    }
+    if constexpr (Derived::order == reach::both) {
+      std::unique_ptr<word_type[]> tmp(new word_type[n]);
+      for (std::size_t i = 0; i < n; ++i) {
+        tmp[i] = masked_word(i);
+      }
+      for (std::size_t i = 0; i < n; ++i) {
+        dst[i] = f(dst[i], tmp[i]);
+      }
+    } else if constexpr (Derived::order == reach::behind) {
+      dst[n - 1] = f(dst[n - 1], masked_word(n - 1));
+      for (std::size_t i = n - 1; i-- > 0;) {
+        dst[i] = f(dst[i], self().word(i));
+      }
+    } else {
+      for (std::size_t i = 0; i + 1 < n; ++i) {
+        dst[i] = f(dst[i], self().word(i));
+      }
+      dst[n - 1] = f(dst[n - 1], masked_word(n - 1));
+    }
+  }
+
+  void evaluate(word_type* dst) const {
+    evaluate(dst, [](word_type, word_type w) { return w; });
+  }
+
+private:
+  const Derived& self() const {
+    return static_cast<const Derived&>(*this);
+  }
+};
+
+template <typename E>
+concept node = std::derived_from<std::remove_cvref_t<E>, expression<std::remove_cvref_t<E>>>;
+
+template <typename E>
+concept operand = node<E> || std::convertible_to<const E&, const_view>;
+
+class leaf : public expression<leaf> {
+public:
+  static constexpr reach order = reach::same;
+
+  leaf(const const_view& view)
+      : _view(view)
+      , _words(view.first_word())
+      , _aligned(view.bit_offset() == 0) {}
+
+  std::size_t size() const {
+    return _view.size();
+  }
+
+  word_type word(std::size_t i) const {
+    return _aligned ? _words[i] : _view.get_nth_word(i);
+  }
+
+private:
+  const_view _view;
+  const word_type* _words;
+  bool _aligned;
+};
+
+template <typename Op, typename L, typename R>
+class binary_node : public expression<binary_node<Op, L, R>> {
+public:
+  static constexpr reach order = combine(L::order, R::order);
+
+  binary_node(const L& left, const R& right)
+      : _left(left)
+      , _right(right) {}
+
+  std::size_t size() const {
+    return _left.size();
+  }
+
+  word_type word(std::size_t i) const {
+    return Op()(_left.word(i), _right.word(i));
+  }
+
+private:
+  L _left;
+  R _right;
+};
+
+template <typename E>
+class not_node : public expression<not_node<E>> {
+public:
+  static constexpr reach order = E::order;
+
+  explicit not_node(const E& arg)
+      : _arg(arg) {}
+
+  std::size_t size() const {
+    return _arg.size();
+  }
+
+  word_type word(std::size_t i) const {
+    return ~_arg.word(i);
+  }
+
+private:
+  E _arg;
+};
+
+// Same-size logical shifts, see bitset_view::shift_left and bitset_view::shift_right
+template <typename E>
+class shift_left_node : public expression<shift_left_node<E>> {
+public:
+  static constexpr reach order = combine(E::order, reach::ahead);
+
+  shift_left_node(const E& arg, std::size_t count)
+      : _arg(arg)
+      , _words(bitset_utils::word_ind(count))
+      , _bits(bitset_utils::offset(count))
+      , _empty(count >= arg.size()) {}
+
+  std::size_t size() const {
+    return _arg.size();
+  }
+
+  word_type word(std::size_t i) const {
+    if (_empty) {
+      return 0;
+    }
+    word_type w = load(i + _words) << _bits;
+    if (_bits > 0) {
+      w |= load(i + _words + 1) >> (bitset_utils::word_size - _bits);
+    }
+    return w;
+  }
+
+private:
+  E _arg;
+  std::size_t _words;
+  std::size_t _bits;
+  bool _empty;
+
+  word_type load(std::size_t i) const {
+    return i < _arg.words_count() ? _arg.masked_word(i) : 0;
+  }
+};
+
+template <typename E>
+class shift_right_node : public expression<shift_right_node<E>> {
+public:
+  static constexpr reach order = combine(E::order, reach::behind);
+
+  shift_right_node(const E& arg, std::size_t count)
+      : _arg(arg)
+      , _words(bitset_utils::word_ind(count))
+      , _bits(bitset_utils::offset(count))
+      , _empty(count >= arg.size()) {}
+
+  std::size_t size() const {
+    return _arg.size();
+  }
+
+  word_type word(std::size_t i) const {
+    if (_empty || i < _words) {
+      return 0;
+    }
+    word_type w = _arg.word(i - _words) >> _bits;
+    if (_bits > 0 && i > _words) {
+      w |= _arg.word(i - _words - 1) << (bitset_utils::word_size - _bits);
+    }
+    return w;
+  }
+
+private:
+  E _arg;
+  std::size_t _words;
+  std::size_t _bits;
+  bool _empty;
+};
+
+template <node E>
+const E& wrap(const E& e) {
+  return e;
+}
+
+inline leaf wrap(const const_view& view) {
+  return leaf(view);
+}
+
+template <operand E>
+using node_t = std::remove_cvref_t<decltype(wrap(std::declval<const E&>()))>;
+
+template <typename Op, operand L, operand R>
+binary_node<Op, node_t<L>, node_t<R>> make_binary(const L& left, const R& right) {
+  return {wrap(left), wrap(right)};
+}
+
+template <operand L, operand R>
+bool equal(const L& left, const R& right) {
+  node_t<L> l = wrap(left);
+  node_t<R> r = wrap(right);
+  if (l.size() != r.size()) {
+    return false;
+  }
+  for (std::size_t i = 0; i < l.words_count(); ++i) {
+    if (l.masked_word(i) != r.masked_word(i)) {
+      return false;
+    }
+  }
+  return true;
+}
+} // namespace bitset_expr
+
+template <bitset_expr::operand L, bitset_expr::operand R>
+auto operator&(const L& left, const R& right) {
+  return bitset_expr::make_binary<std::bit_and<>>(left, right);
+}
+
+template <bitset_expr::operand L, bitset_expr::operand R>
+auto operator|(const L& left, const R& right) {
+  return bitset_expr::make_binary<std::bit_or<>>(left, right);
+}
+
+template <bitset_expr::operand L, bitset_expr::operand R>
+auto operator^(const L& left, const R& right) {
+  return bitset_expr::make_binary<std::bit_xor<>>(left, right);
+}
+
+// Lazy same-size shifts, e.g. `a |= shifted_left(b, k)` is evaluated in one pass without temporaries
+template <bitset_expr::operand E>
+bitset_expr::shift_left_node<bitset_expr::node_t<E>> shifted_left(const E& arg, std::size_t count) {
+  return {bitset_expr::wrap(arg), count};
+}
+
+template <bitset_expr::operand E>
+bitset_expr::shift_right_node<bitset_expr::node_t<E>> shifted_right(const E& arg, std::size_t count) {
+  return {bitset_expr::wrap(arg), count};
+}
+
+template <bitset_expr::operand E>
+bitset_expr::not_node<bitset_expr::node_t<E>> operator~(const E& arg) {
+  return bitset_expr::not_node<bitset_expr::node_t<E>>(bitset_expr::wrap(arg));
+}
+
+template <bitset_expr::operand L, bitset_expr::operand R>
+  requires (bitset_expr::node<L> || bitset_expr::node<R>)
+bool operator==(const L& left, const R& right) {
+  return bitset_expr::equal(left, right);
+}
+
+template <bitset_expr::operand L, bitset_expr::operand R>
+  requires (bitset_expr::node<L> || bitset_expr::node<R>)
+bool operator!=(const L& left, const R& right) {
+  return !bitset_expr::equal(left, right);
+}
+
+// Every word of the expression is evaluated once and written 64 characters at a time
+template <bitset_expr::node E>
+std::ostream& operator<<(std::ostream& out, const E& e) {
+  char buf[bitset_utils::word_size];
+  for (std::size_t i = 0; i * bitset_utils::word_size < e.size(); ++i) {
+    std::size_t bits = std::min(bitset_utils::word_size, e.size() - i * bitset_utils::word_size);
+    bitset_format::format_word(e.word(i), bits, buf);
+    out.write(buf, bits);
+  }
+  return out;
+}
@@ -0,0 +1,66 @@
+#include "bitset-format.h"
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace bitset_format {
+namespace {
+constexpr uint64_t ascii_ones = 0x3131313131313131ULL;
+constexpr uint64_t low_bits = 0x7f7f7f7f7f7f7f7fULL;
+// Moves the lowest bit of byte k to bit 63 - k, no two partial products overlap
+constexpr uint64_t gather = 0x8040201008040201ULL;
+
+constexpr std::array<std::array<char, 8>, 256> make_table() {
+  std::array<std::array<char, 8>, 256> res{};
+  for (std::size_t b = 0; b < 256; ++b) {
+    for (std::size_t i = 0; i < 8; ++i) {
+      res[b][i] = static_cast<char>('0' + ((b >> (7 - i)) & 1));
+    }
+  }
+  return res;
+}
+
+constexpr std::array<std::array<char, 8>, 256> byte_chars = make_table();
+
+// Eight characters starting at str, the first one becomes the highest bit of the byte. A bit is set
+// exactly for a '1', like in the tail of parse_word.
+uint64_t parse_byte(const char* str) {
+  uint64_t v;
+  std::memcpy(&v, str, sizeof(v));
+  if constexpr (std::endian::native == std::endian::big) {
+    v = __builtin_bswap64(v);
+  }
+  // a byte of x is zero for a '1'; the sum sets the top bit of every nonzero byte without carrying
+  // into the next one
+  uint64_t x = v ^ ascii_ones;
+  uint64_t nonzero = ((x & low_bits) + low_bits) | x;
+  uint64_t ones = (~nonzero & ~low_bits) >> 7;
+  return (ones * gather) >> 56;
+}
+} // namespace
+
+word_type parse_word(const char* str, std::size_t bits) {
+  word_type res = 0;
+  std::size_t i = 0;
+  for (; i + 8 <= bits; i += 8) {
+    res |= parse_byte(str + i) << (bitset_utils::word_size - 8 - i);
+  }
+  for (; i < bits; ++i) {
+    res |= static_cast<word_type>(str[i] == '1') << (bitset_utils::word_size - 1 - i);
+  }
+  return res;
+}
+
+void format_word(word_type word, std::size_t bits, char* out) {
+  std::size_t i = 0;
+  for (; i + 8 <= bits; i += 8) {
+    std::memcpy(out + i, byte_chars[(word >> (bitset_utils::word_size - 8 - i)) & 0xff].data(), 8);
+  }
+  if (i < bits) {
+    std::memcpy(out + i, byte_chars[(word >> (bitset_utils::word_size - 8 - i)) & 0xff].data(), bits - i);
+  }
+}
+} // namespace bitset_format
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "bitset-utils.h"
+
+#include <cstddef>
+
+// Conversion between words and '0'/'1' characters, 8 bits per step
+namespace bitset_format {
+using word_type = bitset_utils::word_type;
+
+// First bits characters of str packed from the most significant bit, the rest of the word is 0
+word_type parse_word(const char* str, std::size_t bits);
+
+// Writes the first bits bits of word to out as '0'/'1'
+void format_word(word_type word, std::size_t bits, char* out);
+} // namespace bitset_format
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "bitset-utils.h"
+#include "bitset-view.h"
+
+#include <bit>
+#include <cstddef>
+#include <iterator>
+
+// Forward iterator over the positions of set bits, it walks whole words and skips zero ones
+class bitset_ones_iterator {
+public:
+  using word_type = bitset_utils::word_type;
+  using const_view = bitset_view<const word_type>;
+  using value_type = std::size_t;
+  using reference = std::size_t;
+  using pointer = void;
+  using difference_type = std::ptrdiff_t;
+  using iterator_category = std::forward_iterator_tag;
+
+  bitset_ones_iterator() = default;
+
+  bitset_ones_iterator(const const_view& view, std::size_t word_ind)
+      : _view(view)
+      , _ind(word_ind)
+      , _word(0) {
+    skip_zero_words();
+  }
+
+  std::size_t operator*() const {
+    return _ind * bitset_utils::word_size + std::countl_zero(_word);
+  }
+
+  bitset_ones_iterator& operator++() {
+    _word ^= max_bit >> std::countl_zero(_word);
+    if (_word == 0) {
+      ++_ind;
+      skip_zero_words();
+    }
+    return *this;
+  }
+
+  bitset_ones_iterator operator++(int) {
+    bitset_ones_iterator res(*this);
+    ++(*this);
+    return res;
+  }
+
+  friend bool operator==(const bitset_ones_iterator& lhs, const bitset_ones_iterator& rhs) {
+    return lhs._ind == rhs._ind && lhs._word == rhs._word;
+  }
+
+  friend bool operator!=(const bitset_ones_iterator& lhs, const bitset_ones_iterator& rhs) {
+    return !(lhs == rhs);
+  }
+
+private:
+  static constexpr word_type max_bit = 1ULL << (bitset_utils::word_size - 1);
+
+  const_view _view;
+  std::size_t _ind;
+  word_type _word;
+
+  void skip_zero_words() {
+    std::size_t n = _view.words_count();
+    bool aligned = _view.bit_offset() == 0;
+    for (; _ind < n; ++_ind) {
+      _word = aligned && _ind + 1 < n ? _view.first_word()[_ind] : _view.get_nth_word(_ind);
+      if (_word) {
+        return;
+      }
+    }
+    _ind = n;
+    _word = 0;
+  }
+};
+
+class bitset_ones_range {
+public:
+  explicit bitset_ones_range(const bitset_view<const bitset_utils::word_type>& view)
+      : _view(view) {}
+
+  bitset_ones_iterator begin() const {
+    return {_view, 0};
+  }
+
+  bitset_ones_iterator end() const {
+    return {_view, _view.words_count()};
+  }
+
+private:
+  bitset_view<const bitset_utils::word_type> _view;
+};
+
+// Positions of the set bits of a view, in increasing order: `for (std::size_t i : ones(bs))`
+inline bitset_ones_range ones(const bitset_view<const bitset_utils::word_type>& view) {
+  return bitset_ones_range(view);
+}
@@ -0,0 +1,58 @@
+// Checks of the parallel bitset operations. Build it next to the sources and run it, it prints nothing
+// on success:
+//   g++ -std=c++20 -O2 bitset-parallel-check.cpp bitset-parallel.cpp bitset.cpp bitset-simd.cpp
+//       bitset-format.cpp thread-pool.cpp
+
+#include "bitset-parallel.h"
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace {
+// Every inner bound of a split starts a word on a cache line of v's storage
+void check_split(const bitset_parallel::executor& exec, const bitset::const_view& v) {
+  std::vector<std::size_t> bounds = bitset_parallel::detail::split(exec, v);
+  assert(bounds.front() == 0 && bounds.back() == v.size());
+  for (std::size_t i = 1; i < bounds.size(); ++i) {
+    assert(bounds[i - 1] < bounds[i]);
+  }
+  for (std::size_t i = 1; i + 1 < bounds.size(); ++i) {
+    std::size_t bit = bounds[i] + v.bit_offset();
+    assert(bitset_utils::offset(bit) == 0);
+    auto address = reinterpret_cast<std::uintptr_t>(v.first_word() + bitset_utils::word_ind(bit));
+    assert(address % bitset_parallel::detail::cache_line == 0);
+  }
+}
+
+void check_results(const bitset_parallel::executor& exec, const bitset::view& dst, const bitset::const_view& src) {
+  bitset expected(dst);
+  expected ^= src;
+  bitset_parallel::xor_assign(exec, dst, src);
+  assert(dst == expected);
+  assert(bitset_parallel::count(exec, dst) == expected.count());
+  assert(bitset_parallel::to_string(exec, dst) == to_string(expected));
+}
+} // namespace
+
+int main() {
+  thread_pool pool(4);
+  bitset_parallel::executor exec(pool, 1);
+  std::mt19937_64 rng(8);
+  bitset a(64 * 1024 + 300);
+  bitset b(a.size());
+  for (std::size_t i = 0; i < a.size(); ++i) {
+    a[i] = rng() & 1;
+    b[i] = rng() & 1;
+  }
+  // offsets up to a line and a half, so both aligned and misaligned first words are covered
+  for (std::size_t offset = 0; offset < 12 * bitset_utils::word_size; offset += 13) {
+    for (std::size_t count : {a.size() - offset, std::size_t(64 * 100), std::size_t(64 * 100 + 7)}) {
+      bitset::view dst = a.subview(offset, count);
+      check_split(exec, dst);
+      check_results(exec, dst, b.subview(offset, count));
+    }
+  }
+}
@@ -0,0 +1,139 @@
+#include "bitset-parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <string>
+#include <vector>
+
+namespace bitset_parallel {
+namespace {
+constexpr std::size_t line_words = detail::cache_line / sizeof(bitset::word_type);
+} // namespace
+
+namespace detail {
+std::vector<std::size_t> split(const executor& exec, const bitset::const_view& v) {
+  std::vector<std::size_t> bounds{0};
+  std::size_t words = v.words_count();
+  std::size_t parts = std::min(words / std::max<std::size_t>(exec.grain_words(), 1), 4 * exec.pool().size());
+  if (parts > 1) {
+    std::size_t step = (words / parts + line_words - 1) / line_words * line_words;
+    auto address = reinterpret_cast<std::uintptr_t>(v.first_word());
+    std::size_t first = (cache_line - address % cache_line) % cache_line / sizeof(bitset::word_type);
+    // word 0 would give an empty first part, the next line-aligned cut is then a whole step later
+    for (std::size_t w = first == 0 ? step : first; ; w += step) {
+      std::size_t bit = w * bitset_utils::word_size - v.bit_offset();
+      if (bit >= v.size()) {
+        break;
+      }
+      if (bit > bounds.back()) {
+        bounds.push_back(bit);
+      }
+    }
+  }
+  bounds.push_back(v.size());
+  return bounds;
+}
+} // namespace detail
+
+namespace {
+using detail::split;
+
+// Calls f(i, from, count) for every part [from, from + count) of a split
+template <typename F>
+void for_parts(const executor& exec, const std::vector<std::size_t>& bounds, F f) {
+  std::size_t parts = bounds.size() - 1;
+  if (parts == 1) {
+    f(0, 0, bounds[1]);
+    return;
+  }
+  exec.pool().run(parts, [&](std::size_t i) { f(i, bounds[i], bounds[i + 1] - bounds[i]); });
+}
+
+template <typename Op>
+void transform(const executor& exec, const bitset::view& dst, const bitset::const_view& src, Op op) {
+  for_parts(exec, split(exec, dst), [&](std::size_t, std::size_t from, std::size_t count) {
+    op(dst.subview(from, count), src.subview(from, count));
+  });
+}
+
+template <typename Op>
+bool find_part(const executor& exec, const bitset::const_view& v, Op op) {
+  std::atomic<bool> found = false;
+  for_parts(exec, split(exec, v), [&](std::size_t, std::size_t from, std::size_t count) {
+    if (!found.load(std::memory_order_relaxed) && op(from, count)) {
+      found.store(true, std::memory_order_relaxed);
+    }
+  });
+  return found;
+}
+} // namespace
+
+executor::executor(thread_pool& pool, std::size_t grain_words)
+    : _pool(&pool)
+    , _grain_words(grain_words) {}
+
+thread_pool& executor::pool() const {
+  return *_pool;
+}
+
+std::size_t executor::grain_words() const {
+  return _grain_words;
+}
+
+void and_assign(const executor& exec, const bitset::view& dst, const bitset::const_view& src) {
+  transform(exec, dst, src, [](const bitset::view& d, const bitset::const_view& s) { d &= s; });
+}
+
+void or_assign(const executor& exec, const bitset::view& dst, const bitset::const_view& src) {
+  transform(exec, dst, src, [](const bitset::view& d, const bitset::const_view& s) { d |= s; });
+}
+
+void xor_assign(const executor& exec, const bitset::view& dst, const bitset::const_view& src) {
+  transform(exec, dst, src, [](const bitset::view& d, const bitset::const_view& s) { d ^= s; });
+}
+
+void flip(const executor& exec, const bitset::view& dst) {
+  for_parts(exec, split(exec, dst), [&](std::size_t, std::size_t from, std::size_t count) {
+    dst.subview(from, count).flip();
+  });
+}
+
+std::size_t count(const executor& exec, const bitset::const_view& src) {
+  std::vector<std::size_t> bounds = split(exec, src);
+  std::vector<std::size_t> partial(bounds.size() - 1, 0);
+  for_parts(exec, bounds, [&](std::size_t i, std::size_t from, std::size_t count) {
+    partial[i] = src.subview(from, count).count();
+  });
+  return std::accumulate(partial.begin(), partial.end(), std::size_t(0));
+}
+
+bool any(const executor& exec, const bitset::const_view& src) {
+  return find_part(exec, src, [&](std::size_t from, std::size_t count) { return src.subview(from, count).any(); });
+}
+
+bool all(const executor& exec, const bitset::const_view& src) {
+  return !find_part(exec, src, [&](std::size_t from, std::size_t count) {
+    return !src.subview(from, count).all();
+  });
+}
+
+bool equal(const executor& exec, const bitset::const_view& lhs, const bitset::const_view& rhs) {
+  if (lhs.size() != rhs.size()) {
+    return false;
+  }
+  return !find_part(exec, lhs, [&](std::size_t from, std::size_t count) {
+    return lhs.subview(from, count) != rhs.subview(from, count);
+  });
+}
+
+std::string to_string(const executor& exec, const bitset::const_view& src) {
+  std::string res(src.size(), '0');
+  for_parts(exec, split(exec, src), [&](std::size_t, std::size_t from, std::size_t count) {
+    src.subview(from, count).format(res.data() + from);
+  });
+  return res;
+}
+} // namespace bitset_parallel
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "bitset.h"
+#include "thread-pool.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Opt-in parallel versions of the bulk bitset operations. Word ranges are split on cache line
+// boundaries of the destination storage, so no two workers ever write the same word or line.
+// Results do not depend on the number of threads.
+namespace bitset_parallel {
+class executor {
+public:
+  // Views shorter than grain_words words are processed on the calling thread
+  explicit executor(thread_pool& pool, std::size_t grain_words = std::size_t(1) << 15);
+
+  thread_pool& pool() const;
+  std::size_t grain_words() const;
+
+private:
+  thread_pool* _pool;
+  std::size_t _grain_words;
+};
+
+void and_assign(const executor& exec, const bitset::view& dst, const bitset::const_view& src);
+void or_assign(const executor& exec, const bitset::view& dst, const bitset::const_view& src);
+void xor_assign(const executor& exec, const bitset::view& dst, const bitset::const_view& src);
+void flip(const executor& exec, const bitset::view& dst);
+
+std::size_t count(const executor& exec, const bitset::const_view& src);
+bool any(const executor& exec, const bitset::const_view& src);
+bool all(const executor& exec, const bitset::const_view& src);
+bool equal(const executor& exec, const bitset::const_view& lhs, const bitset::const_view& rhs);
+
+std::string to_string(const executor& exec, const bitset::const_view& src);
+
+// Internals exposed for bitset-parallel-check.cpp
+namespace detail {
+constexpr std::size_t cache_line = 64;
+
+// Bit offsets inside v where every part but the first starts on a cache line of v's storage
+std::vector<std::size_t> split(const executor& exec, const bitset::const_view& v);
+} // namespace detail
+} // namespace bitset_parallel
@@ -0,0 +1,165 @@
+#include "bitset-rank-select.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+
+bitset_rank_select::bitset_rank_select(const const_view& view)
+    : _view(view)
+    , _source(nullptr)
+    , _version(0)
+    , _valid(false)
+    , _ones(0) {}
+
+bitset_rank_select::bitset_rank_select(const bitset& bs)
+    : _view(bs)
+    , _source(&bs)
+    , _version(bs.version())
+    , _valid(false)
+    , _ones(0) {}
+
+std::size_t bitset_rank_select::rank(std::size_t pos) const {
+  ensure_built();
+  pos = std::min(pos, size());
+  std::size_t w = bitset_utils::word_ind(pos);
+  std::size_t block = w / block_words;
+  std::size_t res = block_rank(block) + relative_rank(block, w % block_words);
+  if (bitset_utils::offset(pos) > 0) {
+    check_word(w);
+    res += std::popcount(word(w) & ~(bitset_utils::mask >> bitset_utils::offset(pos)));
+  }
+  return res;
+}
+
+std::size_t bitset_rank_select::select(std::size_t k) const {
+  ensure_built();
+  if (k >= _ones) {
+    return bitset_utils::npos;
+  }
+  // the wanted block is the last one starting with at most k ones, between two samples
+  std::size_t sample = k / select_sample;
+  std::size_t lo = _samples[sample];
+  std::size_t hi = sample + 1 < _samples.size() ? _samples[sample + 1] + 1 : _blocks.size() / 2;
+  while (hi - lo > 1) {
+    std::size_t mid = lo + (hi - lo) / 2;
+    if (block_rank(mid) <= k) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+  k -= block_rank(lo);
+  std::size_t j = 0;
+  while (j + 1 < block_words && relative_rank(lo, j + 1) <= k) {
+    ++j;
+  }
+  k -= relative_rank(lo, j);
+  check_word(lo * block_words + j);
+  word_type w = word(lo * block_words + j);
+  for (; k > 0; --k) {
+    w &= bitset_utils::mask >> (std::countl_zero(w) + 1);
+  }
+  return (lo * block_words + j) * bitset_utils::word_size + std::countl_zero(w);
+}
+
+std::size_t bitset_rank_select::count() const {
+  ensure_built();
+  return _ones;
+}
+
+std::size_t bitset_rank_select::size() const {
+  return _source != nullptr ? _source->size() : _view.size();
+}
+
+void bitset_rank_select::rebuild() {
+  if (_source != nullptr) {
+    _view = *_source;
+    _version = _source->version();
+  }
+  build();
+}
+
+void bitset_rank_select::rebind(const const_view& view) {
+  _view = view;
+  _source = nullptr;
+  _valid = false;
+}
+
+void bitset_rank_select::rebind(const bitset& bs) {
+  _view = bs;
+  _source = &bs;
+  _version = bs.version();
+  _valid = false;
+}
+
+void bitset_rank_select::build() const {
+  std::size_t words = _view.words_count();
+  // one extra block so that rank(size()) never reads past the index
+  std::size_t blocks = words / block_words + 1;
+  _blocks.assign(2 * blocks, 0);
+  _samples.clear();
+  std::size_t total = 0;
+  for (std::size_t b = 0; b < blocks; ++b) {
+    _blocks[2 * b] = total;
+    uint64_t relative = 0;
+    std::size_t in_block = 0;
+    for (std::size_t j = 0; j < block_words; ++j) {
+      if (j > 0) {
+        relative |= static_cast<uint64_t>(in_block) << (relative_bits * (j - 1));
+      }
+      std::size_t w = b * block_words + j;
+      std::size_t ones = w < words ? std::popcount(word(w)) : 0;
+      // sample every block that contains the select_sample-th one
+      while (ones > 0 && _samples.size() * select_sample < total + in_block + ones) {
+        _samples.push_back(b);
+      }
+      in_block += ones;
+    }
+    _blocks[2 * b + 1] = relative;
+    total += in_block;
+  }
+  _ones = total;
+  _valid = true;
+}
+
+void bitset_rank_select::ensure_built() const {
+  if (_source != nullptr && _source->version() != _version) {
+    // the words may have moved or changed in number
+    _view = *_source;
+    _version = _source->version();
+    _valid = false;
+  }
+  if (!_valid) {
+    build();
+  }
+}
+
+// The word must still hold as many ones as when the index was built
+void bitset_rank_select::check_word([[maybe_unused]] std::size_t ind) const {
+#ifndef NDEBUG
+  std::size_t block = ind / block_words;
+  std::size_t j = ind % block_words;
+  std::size_t next = j + 1 < block_words ? relative_rank(block, j + 1) : block_rank(block + 1) - block_rank(block);
+  assert(static_cast<std::size_t>(std::popcount(word(ind))) == next - relative_rank(block, j) &&
+         "bitset_rank_select queried after the bits changed, call rebuild()");
+#endif
+}
+
+bitset_rank_select::word_type bitset_rank_select::word(std::size_t ind) const {
+  if (_view.bit_offset() == 0 && ind + 1 < _view.words_count()) {
+    return _view.first_word()[ind];
+  }
+  return _view.get_nth_word(ind);
+}
+
+std::size_t bitset_rank_select::block_rank(std::size_t block) const {
+  return _blocks[2 * block];
+}
+
+std::size_t bitset_rank_select::relative_rank(std::size_t block, std::size_t word_in_block) const {
+  if (word_in_block == 0) {
+    return 0;
+  }
+  return (_blocks[2 * block + 1] >> (relative_bits * (word_in_block - 1))) & ((1u << relative_bits) - 1);
+}
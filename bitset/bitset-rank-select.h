@@ -0,0 +1,67 @@
+#pragma once
+
+#include "bitset-utils.h"
+#include "bitset-view.h"
+#include "bitset.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Succinct rank/select index over a bitset view (rank9 layout with sampled select).
+//
+// An index over a whole bitset follows its version(): it is rebuilt on the first query after the
+// bitset was modified by one of its members (assignments, compound operators, shifts, rotations,
+// flip, set, reset and swap), which covers resizes and reassignments too. Writes through data(),
+// views, references or iterators are not tracked, neither for a whole bitset nor for a plain view:
+// call rebuild() after them. Debug builds assert on a query that reads a word whose count no longer
+// matches the index.
+//
+// Queries are const but may rebuild the index, so concurrent queries need external synchronization
+// after the bits changed until the first query has finished.
+class bitset_rank_select {
+public:
+  using word_type = bitset_utils::word_type;
+  using const_view = bitset_view<const word_type>;
+
+  explicit bitset_rank_select(const const_view& view);
+  explicit bitset_rank_select(const bitset& bs);
+
+  // Number of set bits in [0, pos), O(1)
+  std::size_t rank(std::size_t pos) const;
+
+  // Position of the set bit with zero-based index k or npos, near-constant time
+  std::size_t select(std::size_t k) const;
+
+  std::size_t count() const;
+  std::size_t size() const;
+
+  // Recounts the bits now, O(n)
+  void rebuild();
+  void rebind(const const_view& view);
+  void rebind(const bitset& bs);
+
+private:
+  // Every block covers 8 words: the number of ones before the block and seven packed 9-bit
+  // counts of ones in the first 1..7 words of the block
+  static constexpr std::size_t block_words = 8;
+  static constexpr std::size_t relative_bits = 9;
+  // Block index is stored for every select_sample-th one
+  static constexpr std::size_t select_sample = 4096;
+
+  mutable const_view _view;
+  // the tracked bitset and its version the index was built at, or nullptr for a plain view
+  const bitset* _source;
+  mutable std::size_t _version;
+  mutable bool _valid;
+  mutable std::size_t _ones;
+  mutable std::vector<uint64_t> _blocks;
+  mutable std::vector<std::size_t> _samples;
+
+  void build() const;
+  void ensure_built() const;
+  void check_word(std::size_t ind) const;
+  word_type word(std::size_t ind) const;
+  std::size_t block_rank(std::size_t block) const;
+  std::size_t relative_rank(std::size_t block, std::size_t word_in_block) const;
+};
@@ -0,0 +1,394 @@
+#include "bitset-simd.h"
+
+#include <bit>
+#include <cstddef>
+
+#if !defined(BITSET_NO_SIMD) && defined(__GNUC__) && defined(__x86_64__)
+#define BITSET_SIMD_X86
+#include <immintrin.h>
+#endif
+
+namespace bitset_simd {
+namespace {
+enum class op { bit_and, bit_or, bit_xor };
+
+template <op O>
+word_type apply(word_type a, word_type b) {
+  if constexpr (O == op::bit_and) {
+    return a & b;
+  } else if constexpr (O == op::bit_or) {
+    return a | b;
+  } else {
+    return a ^ b;
+  }
+}
+
+struct kernel_set {
+  const char* name;
+  void (*and_words)(word_type*, const word_type*, std::size_t);
+  void (*or_words)(word_type*, const word_type*, std::size_t);
+  void (*xor_words)(word_type*, const word_type*, std::size_t);
+  void (*not_words)(word_type*, std::size_t);
+  std::size_t (*count_words)(const word_type*, std::size_t);
+  bool (*any_words)(const word_type*, std::size_t);
+  bool (*all_words)(const word_type*, std::size_t);
+  bool (*equal_words)(const word_type*, const word_type*, std::size_t);
+};
+
+namespace scalar {
+template <op O>
+void binary(word_type* dst, const word_type* src, std::size_t n) {
+  for (std::size_t i = 0; i < n; ++i) {
+    dst[i] = apply<O>(dst[i], src[i]);
+  }
+}
+
+void negate(word_type* dst, std::size_t n) {
+  for (std::size_t i = 0; i < n; ++i) {
+    dst[i] = ~dst[i];
+  }
+}
+
+std::size_t count(const word_type* src, std::size_t n) {
+  std::size_t res = 0;
+  for (std::size_t i = 0; i < n; ++i) {
+    res += std::popcount(src[i]);
+  }
+  return res;
+}
+
+bool any(const word_type* src, std::size_t n) {
+  for (std::size_t i = 0; i < n; ++i) {
+    if (src[i]) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool all(const word_type* src, std::size_t n) {
+  for (std::size_t i = 0; i < n; ++i) {
+    if (src[i] != bitset_utils::mask) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool equal(const word_type* lhs, const word_type* rhs, std::size_t n) {
+  for (std::size_t i = 0; i < n; ++i) {
+    if (lhs[i] != rhs[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+constexpr kernel_set kernels = {
+    "scalar", binary<op::bit_and>, binary<op::bit_or>, binary<op::bit_xor>, negate, count, any, all, equal,
+};
+} // namespace scalar
+
+#ifdef BITSET_SIMD_X86
+namespace avx2 {
+#define BITSET_TARGET __attribute__((target("avx2,popcnt")))
+
+constexpr std::size_t step = 4;
+
+BITSET_TARGET inline __m256i load(const word_type* p) {
+  return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+}
+
+BITSET_TARGET inline void store(word_type* p, __m256i v) {
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v);
+}
+
+template <op O>
+BITSET_TARGET void binary(word_type* dst, const word_type* src, std::size_t n) {
+  std::size_t i = 0;
+  for (; i + step <= n; i += step) {
+    __m256i a = load(dst + i);
+    __m256i b = load(src + i);
+    if constexpr (O == op::bit_and) {
+      store(dst + i, _mm256_and_si256(a, b));
+    } else if constexpr (O == op::bit_or) {
+      store(dst + i, _mm256_or_si256(a, b));
+    } else {
+      store(dst + i, _mm256_xor_si256(a, b));
+    }
+  }
+  for (; i < n; ++i) {
+    dst[i] = apply<O>(dst[i], src[i]);
+  }
+}
+
+BITSET_TARGET void negate(word_type* dst, std::size_t n) {
+  const __m256i ones = _mm256_set1_epi64x(-1);
+  std::size_t i = 0;
+  for (; i + step <= n; i += step) {
+    store(dst + i, _mm256_xor_si256(load(dst + i), ones));
+  }
+  for (; i < n; ++i) {
+    dst[i] = ~dst[i];
+  }
+}
+
+// Nibble lookup popcount (Mula et al.), bytes are summed into 64-bit lanes with vpsadbw
+BITSET_TARGET std::size_t count(const word_type* src, std::size_t n) {
+  const __m256i lookup =
+      _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i low = _mm256_set1_epi8(0x0f);
+  __m256i acc = _mm256_setzero_si256();
+  std::size_t i = 0;
+  for (; i + step <= n; i += step) {
+    __m256i v = load(src + i);
+    __m256i lo = _mm256_shuffle_epi8(lookup, _mm256_and_si256(v, low));
+    __m256i hi = _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(v, 4), low));
+    acc = _mm256_add_epi64(acc, _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256()));
+  }
+  std::size_t res = _mm256_extract_epi64(acc, 0) + _mm256_extract_epi64(acc, 1) + _mm256_extract_epi64(acc, 2) +
+                    _mm256_extract_epi64(acc, 3);
+  for (; i < n; ++i) {
+    res += std::popcount(src[i]);
+  }
+  return res;
+}
+
+BITSET_TARGET bool any(const word_type* src, std::size_t n) {
+  std::size_t i = 0;
+  for (; i + step <= n; i += step) {
+    __m256i v = load(src + i);
+    if (!_mm256_testz_si256(v, v)) {
+      return true;
+    }
+  }
+  for (; i < n; ++i) {
+    if (src[i]) {
+      return true;
+    }
+  }
+  return false;
+}
+
+BITSET_TARGET bool all(const word_type* src, std::size_t n) {
+  const __m256i ones = _mm256_set1_epi64x(-1);
+  std::size_t i = 0;
+  for (; i + step <= n; i += step) {
+    if (!_mm256_testc_si256(load(src + i), ones)) {
+      return false;
+    }
+  }
+  for (; i < n; ++i) {
+    if (src[i] != bitset_utils::mask) {
+      return false;
+    }
+  }
+  return true;
+}
+
+BITSET_TARGET bool equal(const word_type* lhs, const word_type* rhs, std::size_t n) {
+  std::size_t i = 0;
+  for (; i + step <= n; i += step) {
+    __m256i diff = _mm256_xor_si256(load(lhs + i), load(rhs + i));
+    if (!_mm256_testz_si256(diff, diff)) {
+      return false;
+    }
+  }
+  for (; i < n; ++i) {
+    if (lhs[i] != rhs[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+#undef BITSET_TARGET
+
+constexpr kernel_set kernels = {
+    "avx2", binary<op::bit_and>, binary<op::bit_or>, binary<op::bit_xor>, negate, count, any, all, equal,
+};
+} // namespace avx2
+
+namespace avx512 {
+#define BITSET_TARGET __attribute__((target("avx512f,avx512bw,popcnt")))
+
+constexpr std::size_t step = 8;
+
+BITSET_TARGET inline __m512i load(const word_type* p) {
+  return _mm512_loadu_si512(p);
+}
+
+BITSET_TARGET inline void store(word_type* p, __m512i v) {
+  _mm512_storeu_si512(p, v);
+}
+
+template <op O>
+BITSET_TARGET void binary(word_type* dst, const word_type* src, std::size_t n) {
+  std::size_t i = 0;
+  for (; i + step <= n; i += step) {
+    __m512i a = load(dst + i);
+    __m512i b = load(src + i);
+    if constexpr (O == op::bit_and) {
+      store(dst + i, _mm512_and_si512(a, b));
+    } else if constexpr (O == op::bit_or) {
+      store(dst + i, _mm512_or_si512(a, b));
+    } else {
+      store(dst + i, _mm512_xor_si512(a, b));
+    }
+  }
+  for (; i < n; ++i) {
+    dst[i] = apply<O>(dst[i], src[i]);
+  }
+}
+
+BITSET_TARGET void negate(word_type* dst, std::size_t n) {
+  const __m512i ones = _mm512_set1_epi64(-1);
+  std::size_t i = 0;
+  for (; i + step <= n; i += step) {
+    store(dst + i, _mm512_xor_si512(load(dst + i), ones));
+  }
+  for (; i < n; ++i) {
+    dst[i] = ~dst[i];
+  }
+}
+
+// Popcounts of the 16 nibbles in every 128-bit lane. The table is loaded and the lanes are summed by
+// hand because _mm512_broadcast_i32x4 and _mm512_reduce_add_epi64 trip -Wuninitialized in GCC 12.
+alignas(64) constexpr unsigned char nibble_counts[64] = {
+    0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+    0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+};
+
+BITSET_TARGET std::size_t count(const word_type* src, std::size_t n) {
+  const __m512i lookup = _mm512_load_si512(nibble_counts);
+  const __m512i low = _mm512_set1_epi8(0x0f);
+  __m512i acc = _mm512_setzero_si512();
+  std::size_t i = 0;
+  for (; i + step <= n; i += step) {
+    __m512i v = load(src + i);
+    __m512i lo = _mm512_shuffle_epi8(lookup, _mm512_and_si512(v, low));
+    __m512i hi = _mm512_shuffle_epi8(lookup, _mm512_and_si512(_mm512_srli_epi16(v, 4), low));
+    acc = _mm512_add_epi64(acc, _mm512_sad_epu8(_mm512_add_epi8(lo, hi), _mm512_setzero_si512()));
+  }
+  alignas(64) word_type lanes[step];
+  _mm512_store_si512(lanes, acc);
+  std::size_t res = 0;
+  for (word_type lane : lanes) {
+    res += lane;
+  }
+  for (; i < n; ++i) {
+    res += std::popcount(src[i]);
+  }
+  return res;
+}
+
+BITSET_TARGET bool any(const word_type* src, std::size_t n) {
+  std::size_t i = 0;
+  for (; i + step <= n; i += step) {
+    __m512i v = load(src + i);
+    if (_mm512_test_epi64_mask(v, v)) {
+      return true;
+    }
+  }
+  for (; i < n; ++i) {
+    if (src[i]) {
+      return true;
+    }
+  }
+  return false;
+}
+
+BITSET_TARGET bool all(const word_type* src, std::size_t n) {
+  const __m512i ones = _mm512_set1_epi64(-1);
+  std::size_t i = 0;
+  for (; i + step <= n; i += step) {
+    if (_mm512_cmpneq_epu64_mask(load(src + i), ones)) {
+      return false;
+    }
+  }
+  for (; i < n; ++i) {
+    if (src[i] != bitset_utils::mask) {
+      return false;
+    }
+  }
+  return true;
+}
+
+BITSET_TARGET bool equal(const word_type* lhs, const word_type* rhs, std::size_t n) {
+  std::size_t i = 0;
+  for (; i + step <= n; i += step) {
+    if (_mm512_cmpneq_epu64_mask(load(lhs + i), load(rhs + i))) {
+      return false;
+    }
+  }
+  for (; i < n; ++i) {
+    if (lhs[i] != rhs[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+#undef BITSET_TARGET
+
+constexpr kernel_set kernels = {
+    "avx512", binary<op::bit_and>, binary<op::bit_or>, binary<op::bit_xor>, negate, count, any, all, equal,
+};
+} // namespace avx512
+#endif
+
+kernel_set select_kernels() {
+#ifdef BITSET_SIMD_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+    return avx512::kernels;
+  }
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+    return avx2::kernels;
+  }
+#endif
+  return scalar::kernels;
+}
+
+const kernel_set& active() {
+  static const kernel_set kernels = select_kernels();
+  return kernels;
+}
+} // namespace
+
+void and_words(word_type* dst, const word_type* src, std::size_t n) {
+  active().and_words(dst, src, n);
+}
+
+void or_words(word_type* dst, const word_type* src, std::size_t n) {
+  active().or_words(dst, src, n);
+}
+
+void xor_words(word_type* dst, const word_type* src, std::size_t n) {
+  active().xor_words(dst, src, n);
+}
+
+void not_words(word_type* dst, std::size_t n) {
+  active().not_words(dst, n);
+}
+
+std::size_t count_words(const word_type* src, std::size_t n) {
+  return active().count_words(src, n);
+}
+
+bool any_words(const word_type* src, std::size_t n) {
+  return active().any_words(src, n);
+}
+
+bool all_words(const word_type* src, std::size_t n) {
+  return active().all_words(src, n);
+}
+
+bool equal_words(const word_type* lhs, const word_type* rhs, std::size_t n) {
+  return active().equal_words(lhs, rhs, n);
+}
+
+const char* active_kernels() {
+  return active().name;
+}
+} // namespace bitset_simd
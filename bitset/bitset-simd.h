@@ -0,0 +1,55 @@
+#pragma once
+
+#include "bitset-utils.h"
+
+#include <cstddef>
+#include <functional>
+
+// Word-array kernels behind the bulk bitset operations. The implementation picks AVX-512, AVX2
+// or a portable scalar loop once at runtime, all of them give bit-identical results.
+namespace bitset_simd {
+using word_type = bitset_utils::word_type;
+
+void and_words(word_type* dst, const word_type* src, std::size_t n);
+void or_words(word_type* dst, const word_type* src, std::size_t n);
+void xor_words(word_type* dst, const word_type* src, std::size_t n);
+void not_words(word_type* dst, std::size_t n);
+
+std::size_t count_words(const word_type* src, std::size_t n);
+bool any_words(const word_type* src, std::size_t n);
+bool all_words(const word_type* src, std::size_t n);
+bool equal_words(const word_type* lhs, const word_type* rhs, std::size_t n);
+
+// Name of the selected kernel set: "avx512", "avx2" or "scalar"
+const char* active_kernels();
+
+template <typename F>
+void transform_words(word_type* dst, const word_type* src, std::size_t n, F f) {
+  for (std::size_t i = 0; i < n; ++i) {
+    dst[i] = f(dst[i], src[i]);
+  }
+}
+
+inline void transform_words(word_type* dst, const word_type* src, std::size_t n, std::bit_and<>) {
+  and_words(dst, src, n);
+}
+
+inline void transform_words(word_type* dst, const word_type* src, std::size_t n, std::bit_or<>) {
+  or_words(dst, src, n);
+}
+
+inline void transform_words(word_type* dst, const word_type* src, std::size_t n, std::bit_xor<>) {
+  xor_words(dst, src, n);
+}
+
+template <typename F>
+void transform_words(word_type* dst, std::size_t n, F f) {
+  for (std::size_t i = 0; i < n; ++i) {
+    dst[i] = f(dst[i]);
+  }
+}
+
+inline void transform_words(word_type* dst, std::size_t n, std::bit_not<>) {
+  not_words(dst, n);
+}
+} // namespace bitset_simd
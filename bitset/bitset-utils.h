@@ -12,11 +12,19 @@ static constexpr size_t word_size = std::numeric_limits<word_type>::digits;
 static constexpr std::size_t npos = -1;
 static constexpr word_type mask = -1;
 
-inline static std::size_t word_ind(std::size_t bit) {
+#ifndef BITSET_INLINE_WORDS
+#define BITSET_INLINE_WORDS 4
+#endif
+
+// Number of words a bitset stores without allocating
+static constexpr std::size_t inline_words = BITSET_INLINE_WORDS;
+static_assert(inline_words > 0);
+
+constexpr std::size_t word_ind(std::size_t bit) {
   return bit / word_size;
 }
 
-inline static std::size_t offset(std::size_t bit) {
+constexpr std::size_t offset(std::size_t bit) {
   return bit % word_size;
 }
 } // namespace bitset_utils
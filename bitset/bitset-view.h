@@ -1,10 +1,14 @@
 #pragma once
 
+#include "bitset-format.h"
 #include "bitset-iterator.h"
+#include "bitset-simd.h"
 #include "bitset-utils.h"
 
+#include <algorithm>
 #include <bit>
 #include <functional>
+#include <memory>
 #include <string>
 
 template <typename T>
@@ -52,32 +56,87 @@ public:
   }
 
   bool all() const {
-    for (std::size_t i = 0; i < words_count(); ++i) {
-      std::size_t sz = std::min(bitset_utils::word_size, size() - i * bitset_utils::word_size);
-      if (get_nth_word(i) != submask(bitset_utils::mask, 0, sz)) {
-        return false;
-      }
+    storage_span sp = span();
+    const word_type* words = first_word();
+    if (sp.head_mask && (words[0] & sp.head_mask) != sp.head_mask) {
+      return false;
     }
-    return true;
+    if (sp.tail_mask && (words[sp.last] & sp.tail_mask) != sp.tail_mask) {
+      return false;
+    }
+    return bitset_simd::all_words(words + sp.first, sp.last - sp.first);
   }
 
   bool any() const {
-    for (std::size_t i = 0; i < words_count(); ++i) {
-      if (get_nth_word(i) > 0) {
-        return true;
-      }
+    storage_span sp = span();
+    const word_type* words = first_word();
+    if (sp.head_mask && (words[0] & sp.head_mask)) {
+      return true;
+    }
+    if (sp.tail_mask && (words[sp.last] & sp.tail_mask)) {
+      return true;
     }
-    return false;
+    return bitset_simd::any_words(words + sp.first, sp.last - sp.first);
   }
 
   std::size_t count() const {
-    std::size_t res = 0;
-    for (std::size_t i = 0; i < words_count(); ++i) {
-      res += std::popcount(get_nth_word(i));
+    storage_span sp = span();
+    const word_type* words = first_word();
+    std::size_t res = bitset_simd::count_words(words + sp.first, sp.last - sp.first);
+    if (sp.head_mask) {
+      res += std::popcount(words[0] & sp.head_mask);
+    }
+    if (sp.tail_mask) {
+      res += std::popcount(words[sp.last] & sp.tail_mask);
     }
     return res;
   }
 
+  // Positions are relative to the view, npos when there is no such bit
+  std::size_t find_first() const {
+    return scan_ones(0);
+  }
+
+  // First set bit after pos
+  std::size_t find_next(std::size_t pos) const {
+    return pos + 1 < size() ? scan_ones(pos + 1) : bitset_utils::npos;
+  }
+
+  // Last set bit before pos
+  std::size_t find_prev(std::size_t pos) const {
+    pos = std::min(pos, size());
+    if (pos == 0) {
+      return bitset_utils::npos;
+    }
+    std::size_t i = bitset_utils::word_ind(pos - 1);
+    word_type w = load_word(i) & (bitset_utils::mask << (bitset_utils::word_size - 1 - bitset_utils::offset(pos - 1)));
+    while (w == 0) {
+      if (i == 0) {
+        return bitset_utils::npos;
+      }
+      w = load_word(--i);
+    }
+    return i * bitset_utils::word_size + bitset_utils::word_size - 1 - std::countr_zero(w);
+  }
+
+  std::size_t find_last() const {
+    return find_prev(size());
+  }
+
+  std::size_t find_first_zero() const {
+    std::size_t n = words_count();
+    for (std::size_t i = 0; i < n; ++i) {
+      word_type w = ~load_word(i);
+      if (i + 1 == n && bitset_utils::offset(size()) > 0) {
+        w &= mask(0, bitset_utils::offset(size()));
+      }
+      if (w) {
+        return i * bitset_utils::word_size + std::countl_zero(w);
+      }
+    }
+    return bitset_utils::npos;
+  }
+
   void swap(bitset_view& other) {
     std::swap(_l_offset, other._l_offset);
     std::swap(_r_offset, other._r_offset);
@@ -126,15 +185,40 @@ public:
     return *this;
   }
 
-  friend std::string to_string(const bitset_view& other) {
-    std::string tmp;
-    tmp.reserve(other.size());
-    for (auto it : other) {
-      tmp.push_back('0' + it);
+  // Copies the bits of other, which must have the same size; other may overlap the view if it
+  // starts after it, as for std::copy
+  bitset_view assign(const const_view& other) const
+    requires (!std::is_const_v<T>)
+  {
+    if (bit_offset() == other.bit_offset()) {
+      T* dst = first_word();
+      const word_type* src = other.first_word();
+      update_storage_words(
+          [&](std::size_t i, word_type) { return src[i]; },
+          [&](std::size_t first, std::size_t n) { std::copy(src + first, src + first + n, dst + first); }
+      );
+      return *this;
+    }
+    for (std::size_t i = 0; i < words_count(); ++i) {
+      set_nth_word(i, other.get_nth_word(i));
     }
+    return *this;
+  }
+
+  friend std::string to_string(const bitset_view& other) {
+    std::string tmp(other.size(), '0');
+    other.format(tmp.data());
     return tmp;
   }
 
+  // Writes size() characters '0'/'1' to out
+  void format(char* out) const {
+    for (std::size_t i = 0; i < words_count(); ++i) {
+      std::size_t bits = std::min(bitset_utils::word_size, size() - i * bitset_utils::word_size);
+      bitset_format::format_word(load_word(i), bits, out + i * bitset_utils::word_size);
+    }
+  }
+
   bitset_view flip() const
     requires (!std::is_const_v<T>)
   {
@@ -156,6 +240,121 @@ public:
     return *this;
   }
 
+  // Fixed-size logical shifts: shift_left moves bit i + count to position i, shift_right moves bit i to
+  // position i + count, vacated bits become 0
+  bitset_view shift_left(std::size_t count) const
+    requires (!std::is_const_v<T>)
+  {
+    if (count >= size()) {
+      return reset();
+    }
+    if (count == 0) {
+      return *this;
+    }
+    std::size_t q = bitset_utils::word_ind(count);
+    std::size_t s = bitset_utils::offset(count);
+    std::size_t n = words_count();
+    std::size_t i = 0;
+    if (bit_offset() == 0) {
+      // plain loop while both source words lie before the possibly partial last word
+      T* w = first_word();
+      std::size_t body = n >= q + 2 ? n - q - 2 : 0;
+      if (s == 0) {
+        std::copy(w + q, w + q + body, w);
+      } else {
+        for (; i < body; ++i) {
+          w[i] = (w[i + q] << s) | (w[i + q + 1] >> (bitset_utils::word_size - s));
+        }
+      }
+      for (i = body; i + q < n; ++i) {
+        store_word(i, shifted_left_word(i, q, s));
+      }
+      if (i < n) {
+        std::fill(w + i, w + n - 1, word_type(0));
+        store_word(n - 1, 0);
+      }
+      return *this;
+    }
+    for (; i < n; ++i) {
+      store_word(i, shifted_left_word(i, q, s));
+    }
+    return *this;
+  }
+
+  bitset_view shift_right(std::size_t count) const
+    requires (!std::is_const_v<T>)
+  {
+    if (count >= size()) {
+      return reset();
+    }
+    if (count == 0) {
+      return *this;
+    }
+    std::size_t q = bitset_utils::word_ind(count);
+    std::size_t s = bitset_utils::offset(count);
+    std::size_t i = words_count();
+    if (bit_offset() == 0) {
+      // the partial last word goes through store_word, the words below it are read and written
+      // directly; bits past the end of the view only ever move further out
+      T* w = first_word();
+      --i;
+      store_word(i, shifted_right_word(i, q, s));
+      if (s == 0) {
+        if (i > q) {
+          std::copy_backward(w, w + i - q, w + i);
+          i = q;
+        }
+      } else {
+        for (; i > q + 1; --i) {
+          w[i - 1] = (w[i - 1 - q] >> s) | (w[i - 2 - q] << (bitset_utils::word_size - s));
+        }
+        if (i == q + 1) {
+          w[q] = w[0] >> s;
+          i = q;
+        }
+      }
+      std::fill(w, w + i, word_type(0));
+      return *this;
+    }
+    while (i-- > 0) {
+      store_word(i, shifted_right_word(i, q, s));
+    }
+    return *this;
+  }
+
+  // Rotations keep only the smaller of the two wrapped-around parts in a scratch buffer
+  bitset_view rotate_left(std::size_t count) const
+    requires (!std::is_const_v<T>)
+  {
+    if (empty() || (count %= size()) == 0) {
+      return *this;
+    }
+    if (count > size() / 2) {
+      return rotate_right(size() - count);
+    }
+    std::unique_ptr<word_type[]> scratch(new word_type[words_count_of(count)]());
+    const_view head = bitset_view<word_type>(0, count, scratch.get()) |= subview(0, count);
+    shift_left(count);
+    subview(size() - count) |= head;
+    return *this;
+  }
+
+  bitset_view rotate_right(std::size_t count) const
+    requires (!std::is_const_v<T>)
+  {
+    if (empty() || (count %= size()) == 0) {
+      return *this;
+    }
+    if (count > size() / 2) {
+      return rotate_left(size() - count);
+    }
+    std::unique_ptr<word_type[]> scratch(new word_type[words_count_of(count)]());
+    const_view tail = bitset_view<word_type>(0, count, scratch.get()) |= subview(size() - count);
+    shift_right(count);
+    subview(0, count) |= tail;
+    return *this;
+  }
+
   std::size_t words_count() const {
     return size() / bitset_utils::word_size + (size() % bitset_utils::word_size > 0);
   }
@@ -196,7 +395,46 @@ public:
     }
   }
 
+  // Storage words touched by the view, counted from first_word(): [first, last) are fully
+  // covered, word first - 1 is a partial head (if head_mask != 0), word last is a partial tail
+  // (if tail_mask != 0).
+  struct storage_span {
+    std::size_t first;
+    std::size_t last;
+    word_type head_mask;
+    word_type tail_mask;
+  };
+
+  std::size_t bit_offset() const {
+    return bitset_utils::offset(_l_offset);
+  }
+
+  T* first_word() const {
+    return _data + bitset_utils::word_ind(_l_offset);
+  }
+
+  storage_span span() const {
+    std::size_t l = bit_offset();
+    std::size_t r = l + size();
+    if (empty()) {
+      return {0, 0, 0, 0};
+    }
+    if (r < bitset_utils::word_size || (l > 0 && r == bitset_utils::word_size)) {
+      return {1, 1, mask(l, r), 0};
+    }
+    std::size_t last = bitset_utils::word_ind(r);
+    return {
+        l > 0,
+        last,
+        l > 0 ? mask(l, bitset_utils::word_size) : 0,
+        bitset_utils::offset(r) > 0 ? mask(0, bitset_utils::offset(r)) : 0
+    };
+  }
+
 private:
+  template <typename U>
+  friend class bitset_view;
+
   std::size_t _l_offset;
   std::size_t _r_offset;
   T* _data;
@@ -209,8 +447,93 @@ private:
     return x & mask(l, r);
   }
 
+  static std::size_t words_count_of(std::size_t bits) {
+    return bitset_utils::word_ind(bits) + (bitset_utils::offset(bits) > 0);
+  }
+
+  // Logical word access that skips the splicing for aligned views and reads zeros past the end
+  word_type load_word(std::size_t ind) const {
+    if (ind >= words_count()) {
+      return 0;
+    }
+    if (bit_offset() == 0 && ind + 1 < words_count()) {
+      return first_word()[ind];
+    }
+    return get_nth_word(ind);
+  }
+
+  // Logical word ind after a shift by q words and s bits, see shift_left and shift_right
+  word_type shifted_left_word(std::size_t ind, std::size_t q, std::size_t s) const {
+    word_type w = load_word(ind + q) << s;
+    if (s > 0) {
+      w |= load_word(ind + q + 1) >> (bitset_utils::word_size - s);
+    }
+    return w;
+  }
+
+  word_type shifted_right_word(std::size_t ind, std::size_t q, std::size_t s) const {
+    word_type w = ind >= q ? load_word(ind - q) >> s : 0;
+    if (s > 0 && ind > q) {
+      w |= load_word(ind - q - 1) << (bitset_utils::word_size - s);
+    }
+    return w;
+  }
+
+  void store_word(std::size_t ind, word_type word) const {
+    if (bit_offset() == 0 && ind + 1 < words_count()) {
+      first_word()[ind] = word;
+    } else {
+      set_nth_word(ind, word);
+    }
+  }
+
+  std::size_t scan_ones(std::size_t pos) const {
+    std::size_t i = bitset_utils::word_ind(pos);
+    std::size_t n = words_count();
+    if (i >= n) {
+      return bitset_utils::npos;
+    }
+    word_type w = load_word(i) & (bitset_utils::mask >> bitset_utils::offset(pos));
+    while (w == 0) {
+      if (++i == n) {
+        return bitset_utils::npos;
+      }
+      w = load_word(i);
+    }
+    return i * bitset_utils::word_size + std::countl_zero(w);
+  }
+
+  static void blend(T& word, word_type value, word_type m) {
+    word = (word & ~m) | (value & m);
+  }
+
+  // Calls edge(i, word) for the partial head and tail storage words and body(words, n) for the
+  // run of fully covered ones, so only the edges pay for masking.
+  template <typename Edge, typename Body>
+  void update_storage_words(Edge edge, Body body) const {
+    storage_span sp = span();
+    T* words = first_word();
+    if (sp.head_mask) {
+      blend(words[0], edge(0, words[0]), sp.head_mask);
+    }
+    body(sp.first, sp.last - sp.first);
+    if (sp.tail_mask) {
+      blend(words[sp.last], edge(sp.last, words[sp.last]), sp.tail_mask);
+    }
+  }
+
   template <typename F>
   void transform(const const_view& other, F f) const {
+    if (bit_offset() == other.bit_offset()) {
+      // both views are equally misaligned, so their storage words line up
+      T* dst = first_word();
+      const word_type* src = other.first_word();
+      update_storage_words(
+          [&](std::size_t i, word_type w) { return f(w, src[i]); },
+          [&](std::size_t first, std::size_t n) { bitset_simd::transform_words(dst + first, src + first, n, f); }
+      );
+      return;
+    }
     for (std::size_t i = 0; i < words_count(); ++i) {
       set_nth_word(i, f(get_nth_word(i), other.get_nth_word(i)));
     }
@@ -218,14 +541,18 @@ private:
 
   template <typename F>
   void transform(F f) const {
-    for (std::size_t i = 0; i < words_count(); ++i) {
-      set_nth_word(i, f(get_nth_word(i)));
-    }
+    T* dst = first_word();
+    update_storage_words(
+        [&](std::size_t, word_type w) { return f(w); },
+        [&](std::size_t first, std::size_t n) { bitset_simd::transform_words(dst + first, n, f); }
+    );
   }
 
   void fill_words(word_type val) const {
-    for (std::size_t i = 0; i < words_count(); ++i) {
-      set_nth_word(i, val);
-    }
+    T* dst = first_word();
+    update_storage_words(
+        [&](std::size_t, word_type) { return val; },
+        [&](std::size_t first, std::size_t n) { std::fill_n(dst + first, n, val); }
+    );
   }
 };
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "bitset-utils.h"
+#include "bitset-view.h"
+
+#include <cstddef>
+#include <iterator>
+
+// Logical word of a view: bits [offset, offset + 64) of the view, most significant bit first,
+// bits past the end of the view are 0
+struct bitset_word {
+  std::size_t offset;
+  bitset_utils::word_type word;
+
+  friend bool operator==(const bitset_word& lhs, const bitset_word& rhs) = default;
+};
+
+// Forward iterator over the logical words of a view. Words of an aligned view are read directly,
+// an unaligned view splices each word from two storage words.
+class bitset_word_iterator {
+public:
+  using word_type = bitset_utils::word_type;
+  using const_view = bitset_view<const word_type>;
+  using value_type = bitset_word;
+  using reference = bitset_word;
+  using pointer = void;
+  using difference_type = std::ptrdiff_t;
+  using iterator_category = std::forward_iterator_tag;
+
+  bitset_word_iterator() = default;
+
+  bitset_word_iterator(const const_view& view, std::size_t word_ind)
+      : _view(view)
+      , _ind(word_ind) {}
+
+  bitset_word operator*() const {
+    bool direct = _view.bit_offset() == 0 && _ind + 1 < _view.words_count();
+    return {_ind * bitset_utils::word_size, direct ? _view.first_word()[_ind] : _view.get_nth_word(_ind)};
+  }
+
+  bitset_word_iterator& operator++() {
+    ++_ind;
+    return *this;
+  }
+
+  bitset_word_iterator operator++(int) {
+    bitset_word_iterator res(*this);
+    ++(*this);
+    return res;
+  }
+
+  friend bool operator==(const bitset_word_iterator& lhs, const bitset_word_iterator& rhs) {
+    return lhs._ind == rhs._ind;
+  }
+
+  friend bool operator!=(const bitset_word_iterator& lhs, const bitset_word_iterator& rhs) {
+    return !(lhs == rhs);
+  }
+
+private:
+  const_view _view;
+  std::size_t _ind;
+};
+
+class bitset_word_range {
+public:
+  explicit bitset_word_range(const bitset_view<const bitset_utils::word_type>& view)
+      : _view(view) {}
+
+  bitset_word_iterator begin() const {
+    return {_view, 0};
+  }
+
+  bitset_word_iterator end() const {
+    return {_view, _view.words_count()};
+  }
+
+  std::size_t size() const {
+    return _view.words_count();
+  }
+
+private:
+  bitset_view<const bitset_utils::word_type> _view;
+};
+
+// Logical words of a view in order: `for (auto [offset, word] : words(bs))`
+inline bitset_word_range words(const bitset_view<const bitset_utils::word_type>& view) {
+  return bitset_word_range(view);
+}
@@ -1,42 +1,49 @@
 #include "bitset.h"
 
 #include <algorithm>
+#include <array>
 #include <cstddef>
+#include <cstdint>
 #include <ostream>
 #include <string>
 #include <string_view>
 
 bitset::bitset()
-    : _size(0)
-    , _data(nullptr) {}
+    : bitset(0) {}
 
 bitset::bitset(std::size_t size)
     : _size(size)
-    , _data(size > 0 ? new word_type[word_cnt()]() : nullptr) {}
+    , _storage()
+    , _version(0) {
+  if (!is_small()) {
+    _storage.heap = new word_type[word_cnt()]();
+  }
+}
 
 bitset::bitset(std::size_t size, bool value)
     : bitset(size) {
   if (value && size) {
-    std::fill(_data, _data + word_cnt(), bitset_utils::npos);
+    std::fill(data(), data() + word_cnt(), bitset_utils::npos);
   }
 }
 
 bitset::bitset(const bitset& other)
     : bitset(other.size()) {
-  std::copy_n(other.data(), word_cnt(), _data);
+  std::copy_n(other.data(), word_cnt(), data());
 }
 
 bitset::bitset(std::string_view str)
     : bitset(str.size()) {
-  for (int i = 0; i < str.size(); ++i) {
-    (*this)[i] = str[i] - '0';
+  for (std::size_t i = 0; i < word_cnt(); ++i) {
+    std::size_t bits = std::min(bitset_utils::word_size, size() - i * bitset_utils::word_size);
+    data()[i] = bitset_format::parse_word(str.data() + i * bitset_utils::word_size, bits);
   }
 }
 
 bitset::bitset(const bitset::const_view& other)
     : bitset(other.size()) {
   for (std::size_t i = 0; i < word_cnt(); ++i) {
-    _data[i] = other.get_nth_word(i);
+    data()[i] = other.get_nth_word(i);
   }
 }
 
@@ -67,12 +74,17 @@ bitset& bitset::operator=(const bitset::const_view& other) & {
 }
 
 bitset::~bitset() {
-  delete[] _data;
+  if (!is_small()) {
+    delete[] _storage.heap;
+  }
 }
 
+// Inline words move with the object, so views of a small bitset do not follow the swap
 void bitset::swap(bitset& other) {
   std::swap(_size, other._size);
-  std::swap(_data, other._data);
+  std::swap(_storage, other._storage);
+  ++_version;
+  ++other._version;
 }
 
 std::size_t bitset::size() const {
@@ -88,11 +100,19 @@ bool bitset::empty() const {
 }
 
 bitset::pointer bitset::data() {
-  return _data;
+  return is_small() ? _storage.words : _storage.heap;
 }
 
 bitset::const_pointer bitset::data() const {
-  return _data;
+  return is_small() ? _storage.words : _storage.heap;
+}
+
+std::size_t bitset::version() const {
+  return _version;
+}
+
+bool bitset::is_small() const {
+  return size() <= bitset_utils::inline_words * bitset_utils::word_size;
 }
 
 bitset::reference bitset::operator[](std::size_t index) {
@@ -122,18 +142,21 @@ bitset::const_iterator bitset::end() const {
 bitset& bitset::operator&=(const bitset::const_view& other) & {
   bitset::view tmp(begin(), end());
   tmp &= other;
+  ++_version;
   return *this;
 }
 
 bitset& bitset::operator|=(const bitset::const_view& other) & {
   bitset::view tmp(begin(), end());
   tmp |= other;
+  ++_version;
   return *this;
 }
 
 bitset& bitset::operator^=(const bitset::const_view& other) & {
   bitset::view tmp(begin(), end());
   tmp ^= other;
+  ++_version;
   return *this;
 }
 
@@ -157,18 +180,49 @@ bitset& bitset::operator>>=(std::size_t count) & {
 bitset& bitset::flip() & {
   bitset::view tmp(begin(), end());
   tmp.flip();
+  ++_version;
+  return *this;
+}
+
+bitset& bitset::shift_left(std::size_t count) & {
+  bitset::view tmp(begin(), end());
+  tmp.shift_left(count);
+  ++_version;
+  return *this;
+}
+
+bitset& bitset::shift_right(std::size_t count) & {
+  bitset::view tmp(begin(), end());
+  tmp.shift_right(count);
+  ++_version;
+  return *this;
+}
+
+bitset& bitset::rotate_left(std::size_t count) & {
+  bitset::view tmp(begin(), end());
+  tmp.rotate_left(count);
+  ++_version;
+  return *this;
+}
+
+bitset& bitset::rotate_right(std::size_t count) & {
+  bitset::view tmp(begin(), end());
+  tmp.rotate_right(count);
+  ++_version;
   return *this;
 }
 
 bitset& bitset::set() & {
   bitset::view tmp(begin(), end());
   tmp.set();
+  ++_version;
   return *this;
 }
 
 bitset& bitset::reset() & {
   bitset::view tmp(begin(), end());
   tmp.reset();
+  ++_version;
   return *this;
 }
 
@@ -187,6 +241,31 @@ std::size_t bitset::count() const {
   return tmp.count();
 }
 
+std::size_t bitset::find_first() const {
+  bitset::const_view tmp(begin(), end());
+  return tmp.find_first();
+}
+
+std::size_t bitset::find_next(std::size_t pos) const {
+  bitset::const_view tmp(begin(), end());
+  return tmp.find_next(pos);
+}
+
+std::size_t bitset::find_prev(std::size_t pos) const {
+  bitset::const_view tmp(begin(), end());
+  return tmp.find_prev(pos);
+}
+
+std::size_t bitset::find_last() const {
+  bitset::const_view tmp(begin(), end());
+  return tmp.find_last();
+}
+
+std::size_t bitset::find_first_zero() const {
+  bitset::const_view tmp(begin(), end());
+  return tmp.find_first_zero();
+}
+
 bitset::operator view() {
   return {begin(), end()};
 }
@@ -213,6 +292,18 @@ bool operator==(const bitset::const_view& lhs, const bitset::const_view& rhs) {
   if ((lhs.size()) != (rhs.size())) {
     return false;
   }
+  if (lhs.bit_offset() == rhs.bit_offset()) {
+    bitset::const_view::storage_span sp = lhs.span();
+    const bitset::word_type* l = lhs.first_word();
+    const bitset::word_type* r = rhs.first_word();
+    if (sp.head_mask && ((l[0] ^ r[0]) & sp.head_mask)) {
+      return false;
+    }
+    if (sp.tail_mask && ((l[sp.last] ^ r[sp.last]) & sp.tail_mask)) {
+      return false;
+    }
+    return bitset_simd::equal_words(l + sp.first, r + sp.first, sp.last - sp.first);
+  }
   for (std::size_t i = 0; i < lhs.words_count(); ++i) {
     if (lhs.get_nth_word(i) != rhs.get_nth_word(i)) {
       return false;
@@ -225,40 +316,14 @@ bool operator!=(const bitset::const_view& lhs, const bitset::const_view& rhs) {
   return !(lhs == rhs);
 }
 
-bitset operator&(const bitset::const_view& lhs, const bitset::const_view& rhs) {
-  bitset res(lhs);
-  res &= rhs;
-  return res;
-}
-
-bitset operator|(const bitset::const_view& lhs, const bitset::const_view& rhs) {
-  bitset res(lhs);
-  res |= rhs;
-  return res;
-}
-
-bitset operator^(const bitset::const_view& lhs, const bitset::const_view& rhs) {
-  bitset res(lhs);
-  res ^= rhs;
-  return res;
-}
-
-bitset operator~(const bitset::const_view& lhs) {
-  bitset tmp(lhs);
-  tmp.flip();
-  return tmp;
-}
-
 bitset operator<<(const bitset::const_view& lhs, std::size_t count) {
-  bitset tmp(lhs);
-  tmp <<= count;
+  bitset tmp(lhs.size() + count);
+  tmp.subview(0, lhs.size()) |= lhs;
   return tmp;
 }
 
 bitset operator>>(const bitset::const_view& lhs, std::size_t count) {
-  bitset tmp(lhs);
-  tmp >>= count;
-  return tmp;
+  return bitset(lhs.subview(0, count < lhs.size() ? lhs.size() - count : 0));
 }
 
 std::string to_string(const bitset& bs) {
@@ -272,8 +337,124 @@ std::ostream& operator<<(std::ostream& out, const bitset& bs) {
 }
 
 std::ostream& operator<<(std::ostream& out, const bitset::const_view& v) {
-  for (auto it : v) {
-    out << it;
+  constexpr std::size_t chunk = 64 * bitset_utils::word_size;
+  char buf[chunk];
+  for (std::size_t from = 0; from < v.size(); from += chunk) {
+    bitset::const_view part = v.subview(from, chunk);
+    part.format(buf);
+    out.write(buf, part.size());
   }
   return out;
 }
+
+namespace {
+constexpr char hex_digits[] = "0123456789abcdef";
+constexpr char base64_digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+constexpr std::array<uint8_t, 256> make_decode_table(const char* digits, std::size_t count) {
+  std::array<uint8_t, 256> res{};
+  for (std::size_t i = 0; i < count; ++i) {
+    res[static_cast<unsigned char>(digits[i])] = i;
+  }
+  if (count == 16) {
+    for (std::size_t i = 10; i < 16; ++i) {
+      res['A' + i - 10] = i;
+    }
+  }
+  return res;
+}
+
+constexpr std::array<uint8_t, 256> hex_values = make_decode_table(hex_digits, 16);
+constexpr std::array<uint8_t, 256> base64_values = make_decode_table(base64_digits, 64);
+
+void or_byte(bitset& bs, std::size_t i, uint8_t byte) {
+  std::size_t shift = bitset_utils::word_size - 8 - 8 * (i % sizeof(bitset::word_type));
+  bs.data()[i / sizeof(bitset::word_type)] |= static_cast<bitset::word_type>(byte) << shift;
+}
+
+// Clears the bits past size() that a whole trailing digit may have set
+void trim(bitset& bs, std::size_t size) {
+  if (bitset_utils::offset(size) > 0) {
+    bs.data()[bs.word_cnt() - 1] &= bitset_utils::mask << (bitset_utils::word_size - bitset_utils::offset(size));
+  }
+}
+} // namespace
+
+std::string to_hex(const bitset::const_view& v) {
+  std::string res((v.size() + 3) / 4, '0');
+  for (std::size_t i = 0; i < v.words_count(); ++i) {
+    bitset::word_type w = v.get_nth_word(i);
+    std::size_t first = i * bitset_utils::word_size / 4;
+    std::size_t digits = std::min(bitset_utils::word_size / 4, res.size() - first);
+    for (std::size_t j = 0; j < digits; ++j) {
+      res[first + j] = hex_digits[(w >> (bitset_utils::word_size - 4 - 4 * j)) & 0xf];
+    }
+  }
+  return res;
+}
+
+bitset bitset::from_hex(std::string_view str, std::size_t size) {
+  size = std::min(size, str.size() * 4);
+  bitset res(size);
+  std::size_t digits = (size + 3) / 4;
+  for (std::size_t i = 0; i < digits; ++i) {
+    std::size_t shift = bitset_utils::word_size - 4 - 4 * (i % (bitset_utils::word_size / 4));
+    res.data()[i / (bitset_utils::word_size / 4)] |=
+        static_cast<word_type>(hex_values[static_cast<unsigned char>(str[i])]) << shift;
+  }
+  trim(res, size);
+  return res;
+}
+
+std::string to_base64(const bitset::const_view& v) {
+  std::size_t bytes = (v.size() + 7) / 8;
+  std::string res;
+  res.reserve((bytes + 2) / 3 * 4);
+  // bytes of the current group of three, most significant first
+  uint32_t group = 0;
+  std::size_t n = 0;
+  auto put_group = [&] {
+    group <<= 8 * (3 - n);
+    for (std::size_t j = 0; j < 4; ++j) {
+      res.push_back(j <= n ? base64_digits[(group >> (18 - 6 * j)) & 0x3f] : '=');
+    }
+    group = 0;
+    n = 0;
+  };
+  // every word is fetched once, an unaligned view splices it from two words
+  for (std::size_t i = 0; i < v.words_count(); ++i) {
+    bitset::word_type w = v.get_nth_word(i);
+    std::size_t count = std::min(sizeof(bitset::word_type), bytes - i * sizeof(bitset::word_type));
+    for (std::size_t j = 0; j < count; ++j) {
+      group = group << 8 | static_cast<uint8_t>(w >> (bitset_utils::word_size - 8 - 8 * j));
+      if (++n == 3) {
+        put_group();
+      }
+    }
+  }
+  if (n > 0) {
+    put_group();
+  }
+  return res;
+}
+
+bitset bitset::from_base64(std::string_view str, std::size_t size) {
+  while (!str.empty() && str.back() == '=') {
+    str.remove_suffix(1);
+  }
+  std::size_t bytes = str.size() * 6 / 8;
+  size = std::min(size, bytes * 8);
+  bitset res(size);
+  std::size_t used = (size + 7) / 8;
+  for (std::size_t i = 0, byte = 0; byte < used; i += 4) {
+    uint32_t group = 0;
+    for (std::size_t j = 0; j < 4 && i + j < str.size(); ++j) {
+      group |= static_cast<uint32_t>(base64_values[static_cast<unsigned char>(str[i + j])]) << (18 - 6 * j);
+    }
+    for (std::size_t j = 0; j < 3 && byte < used; ++j, ++byte) {
+      or_byte(res, byte, group >> (16 - 8 * j));
+    }
+  }
+  trim(res, size);
+  return res;
+}
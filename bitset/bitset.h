@@ -1,10 +1,14 @@
 #pragma once
 
+#include "bitset-expr.h"
+#include "bitset-ones-iterator.h"
 #include "bitset-utils.h"
 #include "bitset-view.h"
+#include "bitset-word-range.h"
 
 #include <cstddef>
 #include <cstdint>
+#include <iterator>
 #include <string_view>
 
 class bitset {
@@ -26,14 +30,39 @@ public:
   bitset(std::size_t size);
   bitset(std::size_t size, bool value);
   bitset(const bitset& other);
+  // '1' is a set bit, every other character a clear one
   explicit bitset(std::string_view str);
   explicit bitset(const const_view& other);
   bitset(const_iterator first, const_iterator last);
 
+  template <bitset_expr::node E>
+  bitset(const E& expr)
+      : bitset(expr.size()) {
+    expr.evaluate(data());
+  }
+
+  // size defaults to every bit the digits encode. Input is not validated: a character outside the
+  // alphabet decodes as zero bits, as any character other than '1' does in the string constructor.
+  static bitset from_hex(std::string_view str, std::size_t size = npos);
+  static bitset from_base64(std::string_view str, std::size_t size = npos);
+
   bitset& operator=(const bitset& other) &;
   bitset& operator=(std::string_view str) &;
   bitset& operator=(const const_view& other) &;
 
+  // Reuses the buffer when the size matches
+  template <bitset_expr::node E>
+  bitset& operator=(const E& expr) & {
+    if (expr.size() == size()) {
+      expr.evaluate(data());
+      ++_version;
+    } else {
+      bitset tmp(expr);
+      swap(tmp);
+    }
+    return *this;
+  }
+
   ~bitset();
 
   void swap(bitset& other);
@@ -45,6 +74,11 @@ public:
   pointer data();
   const_pointer data() const;
 
+  // Changes on every modification made by a member of bitset: assignments, compound operators,
+  // shifts, rotations, flip, set, reset and swap. Writes through data(), references, iterators or views
+  // are not counted.
+  std::size_t version() const;
+
   reference operator[](std::size_t index);
   const_reference operator[](std::size_t index) const;
 
@@ -57,10 +91,38 @@ public:
   bitset& operator&=(const const_view& other) &;
   bitset& operator|=(const const_view& other) &;
   bitset& operator^=(const const_view& other) &;
+
+  template <bitset_expr::node E>
+  bitset& operator&=(const E& expr) & {
+    expr.evaluate(data(), std::bit_and<>());
+    ++_version;
+    return *this;
+  }
+
+  template <bitset_expr::node E>
+  bitset& operator|=(const E& expr) & {
+    expr.evaluate(data(), std::bit_or<>());
+    ++_version;
+    return *this;
+  }
+
+  template <bitset_expr::node E>
+  bitset& operator^=(const E& expr) & {
+    expr.evaluate(data(), std::bit_xor<>());
+    ++_version;
+    return *this;
+  }
+
   bitset& operator<<=(std::size_t count) &;
   bitset& operator>>=(std::size_t count) &;
   bitset& flip() &;
 
+  // In-place shifts and rotations that keep the size, see bitset_view::shift_left
+  bitset& shift_left(std::size_t count) &;
+  bitset& shift_right(std::size_t count) &;
+  bitset& rotate_left(std::size_t count) &;
+  bitset& rotate_right(std::size_t count) &;
+
   bitset& set() &;
   bitset& reset() &;
 
@@ -68,6 +130,12 @@ public:
   bool any() const;
   std::size_t count() const;
 
+  std::size_t find_first() const;
+  std::size_t find_next(std::size_t pos) const;
+  std::size_t find_prev(std::size_t pos) const;
+  std::size_t find_last() const;
+  std::size_t find_first_zero() const;
+
   operator const_view() const;
   operator view();
 
@@ -75,8 +143,17 @@ public:
   const_view subview(std::size_t offset = 0, std::size_t count = npos) const;
 
 private:
+  // Bitsets of up to inline_words words keep them in place of the heap pointer
+  union storage {
+    word_type words[bitset_utils::inline_words];
+    pointer heap;
+  };
+
   std::size_t _size;
-  pointer _data;
+  storage _storage;
+  std::size_t _version;
+
+  bool is_small() const;
 };
 
 bool operator==(const bitset::const_view& left, const bitset::const_view& right);
@@ -86,11 +163,59 @@ void swap(bitset& lhs, bitset& rhs);
 std::string to_string(const bitset& bs);
 std::ostream& operator<<(std::ostream& out, const bitset& bs);
 
-bitset operator&(const bitset::const_view& lhs, const bitset::const_view& rhs);
-bitset operator|(const bitset::const_view& lhs, const bitset::const_view& rhs);
-bitset operator^(const bitset::const_view& lhs, const bitset::const_view& rhs);
-bitset operator~(const bitset::const_view& lhs);
+// Most significant bit first, the last digit is padded with zero bits; base64 uses the standard
+// alphabet with '=' padding over the bits packed into bytes
+std::string to_hex(const bitset::const_view& bs);
+std::string to_base64(const bitset::const_view& bs);
+
+// A view may alias the operands of the expression, so the expression is materialized first
+template <bitset_expr::node E>
+bitset::view operator&=(const bitset::view& lhs, const E& rhs) {
+  return lhs &= bitset(rhs);
+}
+
+template <bitset_expr::node E>
+bitset::view operator|=(const bitset::view& lhs, const E& rhs) {
+  return lhs |= bitset(rhs);
+}
+
+template <bitset_expr::node E>
+bitset::view operator^=(const bitset::view& lhs, const E& rhs) {
+  return lhs ^= bitset(rhs);
+}
+
 bitset operator<<(const bitset::const_view& lhs, std::size_t count);
 bitset operator>>(const bitset::const_view& lhs, std::size_t count);
 
 std::ostream& operator<<(std::ostream& out, const bitset::const_view& bs);
+
+// Overloads of the standard algorithms for bitset iterators that work on whole words. They are
+// found by argument-dependent lookup, so an unqualified call such as `copy(a.begin(), a.end(), out)`
+// picks them over the generic std versions.
+template <typename T, typename U>
+bitset_iterator<U> copy(bitset_iterator<T> first, bitset_iterator<T> last, bitset_iterator<U> out)
+  requires (!std::is_const_v<U>)
+{
+  bitset_iterator<U> out_last = out + (last - first);
+  bitset_view<U>(out, out_last).assign(bitset_view<const U>(first, last));
+  return out_last;
+}
+
+template <typename T>
+void fill(bitset_iterator<T> first, bitset_iterator<T> last, bool value)
+  requires (!std::is_const_v<T>)
+{
+  bitset_view<T> v(first, last);
+  value ? v.set() : v.reset();
+}
+
+template <typename T, typename U>
+bool equal(bitset_iterator<T> first1, bitset_iterator<T> last1, bitset_iterator<U> first2) {
+  return bitset::const_view(first1, last1) == bitset::const_view(first2, first2 + (last1 - first1));
+}
+
+template <typename T>
+std::iter_difference_t<bitset_iterator<T>> count(bitset_iterator<T> first, bitset_iterator<T> last, bool value) {
+  std::size_t ones = bitset::const_view(first, last).count();
+  return value ? ones : (last - first) - ones;
+}
@@ -0,0 +1,371 @@
+#include "bloom-filter.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <span>
+#include <utility>
+
+namespace {
+using word_type = bitset_utils::word_type;
+
+constexpr word_type max_bit = 1ULL << (bitset_utils::word_size - 1);
+// Keys of a batch whose words are prefetched before any of them is touched
+constexpr std::size_t batch_size = 16;
+constexpr std::align_val_t cache_line{64};
+
+// Murmur3 finalizer, spreads weak hashes over all 64 bits
+std::uint64_t mix(std::uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+// High 64 bits of the 128-bit product a * b
+std::uint64_t multiply_high(std::uint64_t a, std::uint64_t b) {
+#ifdef __SIZEOF_INT128__
+  __extension__ using uint128 = unsigned __int128;
+  return static_cast<std::uint64_t>((static_cast<uint128>(a) * b) >> 64);
+#else
+  std::uint64_t a_lo = a & 0xffffffff;
+  std::uint64_t a_hi = a >> 32;
+  std::uint64_t b_lo = b & 0xffffffff;
+  std::uint64_t b_hi = b >> 32;
+  std::uint64_t lo_lo = a_lo * b_lo;
+  std::uint64_t hi_lo = a_hi * b_lo;
+  std::uint64_t lo_hi = a_lo * b_hi;
+  std::uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xffffffff) + lo_hi;
+  return a_hi * b_hi + (hi_lo >> 32) + (cross >> 32);
+#endif
+}
+
+// Hint that the line holding p is read soon, nothing on compilers without the builtin
+void prefetch_line([[maybe_unused]] const void* p) {
+#ifdef __GNUC__
+  __builtin_prefetch(p);
+#endif
+}
+
+// Maps h to [0, n) without a division, the same on every target
+std::size_t reduce(std::uint64_t h, std::size_t n) {
+  return static_cast<std::size_t>(multiply_high(h, n));
+}
+
+// Double hashing: probe i is a + i * b, b is odd so the probes differ
+template <typename F>
+void for_each_probe(std::uint64_t h, std::size_t hashes, std::size_t size, F f) {
+  std::uint64_t a = h;
+  std::uint64_t b = std::rotl(h, 32) | 1;
+  for (std::size_t i = 0; i < hashes; ++i) {
+    f(reduce(a, size));
+    a += b;
+  }
+}
+
+word_type bit(std::size_t pos) {
+  return max_bit >> bitset_utils::offset(pos);
+}
+
+// Prefetches the words of a group of keys, then applies f to each key of the group
+template <typename Prefetch, typename F>
+void for_each_batch(std::span<const std::uint64_t> hashes, Prefetch prefetch, F f) {
+  for (std::size_t first = 0; first < hashes.size(); first += batch_size) {
+    std::size_t last = std::min(first + batch_size, hashes.size());
+    for (std::size_t i = first; i < last; ++i) {
+      prefetch(mix(hashes[i]));
+    }
+    for (std::size_t i = first; i < last; ++i) {
+      f(i, mix(hashes[i]));
+    }
+  }
+}
+
+word_type* allocate_blocks(std::size_t words) {
+  auto* res = static_cast<word_type*>(::operator new[](words * sizeof(word_type), cache_line));
+  std::fill(res, res + words, 0);
+  return res;
+}
+} // namespace
+
+bloom_filter::bloom_filter(std::size_t bits, std::size_t hashes)
+    : _bits(std::max<std::size_t>(bits, 1))
+    , _hashes(std::max<std::size_t>(hashes, 1)) {}
+
+bloom_filter::bloom_filter(const bitset::const_view& bits, std::size_t hashes)
+    : _bits(bits)
+    , _hashes(std::max<std::size_t>(hashes, 1)) {}
+
+std::size_t bloom_filter::optimal_bits(std::size_t keys, double fp_rate) {
+  double ln2 = std::log(2.0);
+  return std::max<std::size_t>(1, std::ceil(-static_cast<double>(keys) * std::log(fp_rate) / (ln2 * ln2)));
+}
+
+std::size_t bloom_filter::optimal_hashes(std::size_t bits, std::size_t keys) {
+  double k = std::round(static_cast<double>(bits) / std::max<std::size_t>(keys, 1) * std::log(2.0));
+  return std::max<std::size_t>(1, k);
+}
+
+std::size_t bloom_filter::size() const {
+  return _bits.size();
+}
+
+std::size_t bloom_filter::hashes() const {
+  return _hashes;
+}
+
+void bloom_filter::prefetch(std::uint64_t h) const {
+  const word_type* data = _bits.data();
+  for_each_probe(h, _hashes, size(), [&](std::size_t pos) { prefetch_line(data + bitset_utils::word_ind(pos)); });
+}
+
+void bloom_filter::insert_mixed(std::uint64_t h) {
+  word_type* data = _bits.data();
+  for_each_probe(h, _hashes, size(), [&](std::size_t pos) { data[bitset_utils::word_ind(pos)] |= bit(pos); });
+}
+
+bool bloom_filter::contains_mixed(std::uint64_t h) const {
+  const word_type* data = _bits.data();
+  bool res = true;
+  for_each_probe(h, _hashes, size(), [&](std::size_t pos) {
+    res &= (data[bitset_utils::word_ind(pos)] & bit(pos)) != 0;
+  });
+  return res;
+}
+
+void bloom_filter::insert(std::uint64_t hash) {
+  insert_mixed(mix(hash));
+}
+
+bool bloom_filter::contains(std::uint64_t hash) const {
+  return contains_mixed(mix(hash));
+}
+
+void bloom_filter::insert(std::span<const std::uint64_t> hashes) {
+  auto add = [&](std::size_t, std::uint64_t h) { insert_mixed(h); };
+  for_each_batch(hashes, [&](std::uint64_t h) { prefetch(h); }, add);
+}
+
+void bloom_filter::contains(std::span<const std::uint64_t> hashes, std::span<bool> out) const {
+  auto query = [&](std::size_t i, std::uint64_t h) { out[i] = contains_mixed(h); };
+  for_each_batch(hashes, [&](std::uint64_t h) { prefetch(h); }, query);
+}
+
+void bloom_filter::clear() {
+  _bits.reset();
+}
+
+bloom_filter& bloom_filter::operator|=(const bloom_filter& other) & {
+  _bits |= other._bits;
+  return *this;
+}
+
+bloom_filter& bloom_filter::operator&=(const bloom_filter& other) & {
+  _bits &= other._bits;
+  return *this;
+}
+
+bitset::const_view bloom_filter::bits() const {
+  return _bits;
+}
+
+blocked_bloom_filter::blocked_bloom_filter(std::size_t bits, std::size_t hashes)
+    : _blocks(std::max<std::size_t>(1, (bits + block_bits - 1) / block_bits))
+    , _hashes(std::clamp<std::size_t>(hashes, 1, block_bits))
+    , _data(allocate_blocks(_blocks * block_words)) {}
+
+blocked_bloom_filter::blocked_bloom_filter(const bitset::const_view& bits, std::size_t hashes)
+    : blocked_bloom_filter(bits.size(), hashes) {
+  for (std::size_t i = 0; i < bits.words_count(); ++i) {
+    _data[i] = bits.get_nth_word(i);
+  }
+}
+
+blocked_bloom_filter::blocked_bloom_filter(const blocked_bloom_filter& other)
+    : blocked_bloom_filter(other.size(), other.hashes()) {
+  std::copy(other._data, other._data + _blocks * block_words, _data);
+}
+
+blocked_bloom_filter& blocked_bloom_filter::operator=(const blocked_bloom_filter& other) & {
+  if (this != &other) {
+    blocked_bloom_filter tmp(other);
+    swap(tmp);
+  }
+  return *this;
+}
+
+blocked_bloom_filter::~blocked_bloom_filter() {
+  ::operator delete[](_data, cache_line);
+}
+
+void blocked_bloom_filter::swap(blocked_bloom_filter& other) {
+  std::swap(_blocks, other._blocks);
+  std::swap(_hashes, other._hashes);
+  std::swap(_data, other._data);
+}
+
+std::size_t blocked_bloom_filter::size() const {
+  return _blocks * block_bits;
+}
+
+std::size_t blocked_bloom_filter::hashes() const {
+  return _hashes;
+}
+
+bitset::view blocked_bloom_filter::words() {
+  return {0, size(), _data};
+}
+
+blocked_bloom_filter::word_type* blocked_bloom_filter::block(std::uint64_t h) const {
+  return _data + reduce(h, _blocks) * block_words;
+}
+
+// The block is picked by the high bits of h through reduce, the in-block probes use a second
+// product so they do not depend on the block
+void blocked_bloom_filter::block_mask(std::uint64_t h, word_type* mask) const {
+  std::fill(mask, mask + block_words, 0);
+  std::uint64_t g = h * 0x9e3779b97f4a7c15ULL;
+  std::size_t a = g >> 55;
+  std::size_t b = ((g >> 46) & (block_bits - 1)) | 1;
+  for (std::size_t i = 0; i < _hashes; ++i) {
+    std::size_t pos = (a + i * b) & (block_bits - 1);
+    mask[bitset_utils::word_ind(pos)] |= bit(pos);
+  }
+}
+
+void blocked_bloom_filter::prefetch(std::uint64_t h) const {
+  prefetch_line(block(h));
+}
+
+void blocked_bloom_filter::insert_mixed(std::uint64_t h) {
+  word_type mask[block_words];
+  block_mask(h, mask);
+  word_type* words = block(h);
+  for (std::size_t i = 0; i < block_words; ++i) {
+    words[i] |= mask[i];
+  }
+}
+
+bool blocked_bloom_filter::contains_mixed(std::uint64_t h) const {
+  word_type mask[block_words];
+  block_mask(h, mask);
+  const word_type* words = block(h);
+  word_type missing = 0;
+  for (std::size_t i = 0; i < block_words; ++i) {
+    missing |= mask[i] & ~words[i];
+  }
+  return missing == 0;
+}
+
+void blocked_bloom_filter::insert(std::uint64_t hash) {
+  insert_mixed(mix(hash));
+}
+
+bool blocked_bloom_filter::contains(std::uint64_t hash) const {
+  return contains_mixed(mix(hash));
+}
+
+void blocked_bloom_filter::insert(std::span<const std::uint64_t> hashes) {
+  auto add = [&](std::size_t, std::uint64_t h) { insert_mixed(h); };
+  for_each_batch(hashes, [&](std::uint64_t h) { prefetch(h); }, add);
+}
+
+void blocked_bloom_filter::contains(std::span<const std::uint64_t> hashes, std::span<bool> out) const {
+  auto query = [&](std::size_t i, std::uint64_t h) { out[i] = contains_mixed(h); };
+  for_each_batch(hashes, [&](std::uint64_t h) { prefetch(h); }, query);
+}
+
+void blocked_bloom_filter::clear() {
+  std::fill(_data, _data + _blocks * block_words, 0);
+}
+
+blocked_bloom_filter& blocked_bloom_filter::operator|=(const blocked_bloom_filter& other) & {
+  words() |= other.bits();
+  return *this;
+}
+
+blocked_bloom_filter& blocked_bloom_filter::operator&=(const blocked_bloom_filter& other) & {
+  words() &= other.bits();
+  return *this;
+}
+
+bitset::const_view blocked_bloom_filter::bits() const {
+  return {0, size(), _data};
+}
+
+void swap(blocked_bloom_filter& lhs, blocked_bloom_filter& rhs) {
+  lhs.swap(rhs);
+}
+
+counting_bloom_filter::counting_bloom_filter(std::size_t counters, std::size_t hashes)
+    : _counters(std::max<std::size_t>(counters, 1) * counter_bits)
+    , _size(std::max<std::size_t>(counters, 1))
+    , _hashes(std::max<std::size_t>(hashes, 1)) {}
+
+std::size_t counting_bloom_filter::size() const {
+  return _size;
+}
+
+std::size_t counting_bloom_filter::hashes() const {
+  return _hashes;
+}
+
+std::size_t counting_bloom_filter::get(std::size_t ind) const {
+  std::size_t pos = ind * counter_bits;
+  std::size_t shift = bitset_utils::word_size - counter_bits - bitset_utils::offset(pos);
+  return (_counters.data()[bitset_utils::word_ind(pos)] >> shift) & max_counter;
+}
+
+void counting_bloom_filter::put(std::size_t ind, std::size_t value) {
+  std::size_t pos = ind * counter_bits;
+  std::size_t shift = bitset_utils::word_size - counter_bits - bitset_utils::offset(pos);
+  word_type& word = _counters.data()[bitset_utils::word_ind(pos)];
+  word = (word & ~(word_type(max_counter) << shift)) | (word_type(value) << shift);
+}
+
+void counting_bloom_filter::insert(std::uint64_t hash) {
+  for_each_probe(mix(hash), _hashes, _size, [&](std::size_t ind) {
+    std::size_t c = get(ind);
+    if (c < max_counter) {
+      put(ind, c + 1);
+    }
+  });
+}
+
+bool counting_bloom_filter::contains(std::uint64_t hash) const {
+  bool res = true;
+  for_each_probe(mix(hash), _hashes, _size, [&](std::size_t ind) { res &= get(ind) > 0; });
+  return res;
+}
+
+void counting_bloom_filter::erase(std::uint64_t hash) {
+  if (!contains(hash)) {
+    return;
+  }
+  for_each_probe(mix(hash), _hashes, _size, [&](std::size_t ind) {
+    std::size_t c = get(ind);
+    if (c < max_counter) {
+      put(ind, c - 1);
+    }
+  });
+}
+
+void counting_bloom_filter::clear() {
+  _counters.reset();
+}
+
+// Probes match bloom_filter of the same size, so the result answers contains the same way
+bloom_filter counting_bloom_filter::to_bloom_filter() const {
+  bitset bits(_size);
+  for (std::size_t i = 0; i < _size; ++i) {
+    if (get(i) > 0) {
+      bits[i] = true;
+    }
+  }
+  return {bits, _hashes};
+}
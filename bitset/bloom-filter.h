@@ -0,0 +1,137 @@
+#pragma once
+
+#include "bitset-utils.h"
+#include "bitset.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+// Bloom filters over 64-bit key hashes. Hashes are remixed before use, so std::hash values, which
+// may be the identity, are fine. Batched insert and contains first prefetch the words of every key
+// in a group and only then touch them, overlapping the cache misses. Union and intersection are
+// defined only for filters with the same size and number of hashes.
+
+// Classic filter: k bits anywhere in a bitset of the given size
+class bloom_filter {
+public:
+  bloom_filter(std::size_t bits, std::size_t hashes);
+  // Restores a filter from its bits, e.g. from a mapped_bitset
+  bloom_filter(const bitset::const_view& bits, std::size_t hashes);
+
+  // Parameters giving the false positive rate fp_rate for the expected number of keys
+  static std::size_t optimal_bits(std::size_t keys, double fp_rate);
+  static std::size_t optimal_hashes(std::size_t bits, std::size_t keys);
+
+  std::size_t size() const;
+  std::size_t hashes() const;
+
+  void insert(std::uint64_t hash);
+  bool contains(std::uint64_t hash) const;
+
+  void insert(std::span<const std::uint64_t> hashes);
+  // out must hold hashes.size() elements
+  void contains(std::span<const std::uint64_t> hashes, std::span<bool> out) const;
+
+  void clear();
+
+  bloom_filter& operator|=(const bloom_filter& other) &;
+  bloom_filter& operator&=(const bloom_filter& other) &;
+
+  bitset::const_view bits() const;
+
+private:
+  bitset _bits;
+  std::size_t _hashes;
+
+  // Take hashes already passed through the mixer
+  void prefetch(std::uint64_t h) const;
+  void insert_mixed(std::uint64_t h);
+  bool contains_mixed(std::uint64_t h) const;
+};
+
+// Blocked filter: a key sets all its k bits inside one 512-bit block aligned to a cache line, so
+// a probe costs a single miss at a slightly higher false positive rate than bloom_filter
+class blocked_bloom_filter {
+public:
+  using word_type = bitset_utils::word_type;
+
+  static constexpr std::size_t block_bits = 512;
+
+  // bits is rounded up to whole blocks
+  blocked_bloom_filter(std::size_t bits, std::size_t hashes);
+  blocked_bloom_filter(const bitset::const_view& bits, std::size_t hashes);
+
+  blocked_bloom_filter(const blocked_bloom_filter& other);
+  blocked_bloom_filter& operator=(const blocked_bloom_filter& other) &;
+
+  ~blocked_bloom_filter();
+
+  void swap(blocked_bloom_filter& other);
+
+  std::size_t size() const;
+  std::size_t hashes() const;
+
+  void insert(std::uint64_t hash);
+  bool contains(std::uint64_t hash) const;
+
+  void insert(std::span<const std::uint64_t> hashes);
+  void contains(std::span<const std::uint64_t> hashes, std::span<bool> out) const;
+
+  void clear();
+
+  blocked_bloom_filter& operator|=(const blocked_bloom_filter& other) &;
+  blocked_bloom_filter& operator&=(const blocked_bloom_filter& other) &;
+
+  bitset::const_view bits() const;
+
+private:
+  static constexpr std::size_t block_words = block_bits / bitset_utils::word_size;
+
+  std::size_t _blocks;
+  std::size_t _hashes;
+  word_type* _data;
+
+  bitset::view words();
+  word_type* block(std::uint64_t h) const;
+  // Writes the in-block bits of h to mask
+  void block_mask(std::uint64_t h, word_type* mask) const;
+
+  void prefetch(std::uint64_t h) const;
+  void insert_mixed(std::uint64_t h);
+  bool contains_mixed(std::uint64_t h) const;
+};
+
+void swap(blocked_bloom_filter& lhs, blocked_bloom_filter& rhs);
+
+// Filter with 4-bit saturating counters instead of bits, so keys can be erased. A counter that
+// reached 15 is never decremented again.
+class counting_bloom_filter {
+public:
+  counting_bloom_filter(std::size_t counters, std::size_t hashes);
+
+  std::size_t size() const;
+  std::size_t hashes() const;
+
+  void insert(std::uint64_t hash);
+  bool contains(std::uint64_t hash) const;
+  // Erasing a hash that was not inserted may remove other keys
+  void erase(std::uint64_t hash);
+
+  void clear();
+
+  // Bloom filter with a bit set for every non-zero counter
+  bloom_filter to_bloom_filter() const;
+
+private:
+  static constexpr std::size_t counter_bits = 4;
+  static constexpr std::size_t max_counter = (1 << counter_bits) - 1;
+
+  // Counters are consecutive 4-bit fields of the bitset, in its bit order
+  bitset _counters;
+  std::size_t _size;
+  std::size_t _hashes;
+
+  std::size_t get(std::size_t ind) const;
+  void put(std::size_t ind, std::size_t value);
+};
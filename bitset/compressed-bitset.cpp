@@ -0,0 +1,643 @@
+#include "compressed-bitset.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <iterator>
+#include <utility>
+
+namespace {
+constexpr bitset_utils::word_type max_bit = 1ULL << (bitset_utils::word_size - 1);
+
+bool test_bit(const std::vector<bitset_utils::word_type>& words, std::size_t pos) {
+  return words[bitset_utils::word_ind(pos)] & (max_bit >> bitset_utils::offset(pos));
+}
+} // namespace
+
+// container
+
+compressed_bitset::container compressed_bitset::container::from_values(std::vector<uint16_t> values) {
+  container res;
+  res.cardinality = values.size();
+  if (res.cardinality <= array_max) {
+    res.values = std::move(values);
+    return res;
+  }
+  res.type = kind::bitmap;
+  res.words.assign(chunk_words, 0);
+  for (uint16_t v : values) {
+    res.words[bitset_utils::word_ind(v)] |= max_bit >> bitset_utils::offset(v);
+  }
+  return res;
+}
+
+compressed_bitset::container compressed_bitset::container::from_words(std::vector<word_type> words) {
+  container res;
+  for (word_type w : words) {
+    res.cardinality += std::popcount(w);
+  }
+  if (res.cardinality > array_max) {
+    res.type = kind::bitmap;
+    res.words = std::move(words);
+    return res;
+  }
+  res.values.reserve(res.cardinality);
+  for (std::size_t i = 0; i < words.size(); ++i) {
+    for (word_type w = words[i]; w != 0; w &= ~(max_bit >> std::countl_zero(w))) {
+      res.values.push_back(i * bitset_utils::word_size + std::countl_zero(w));
+    }
+  }
+  return res;
+}
+
+bool compressed_bitset::container::contains(uint16_t v) const {
+  switch (type) {
+  case kind::array:
+    return std::binary_search(values.begin(), values.end(), v);
+  case kind::bitmap:
+    return test_bit(words, v);
+  default:
+    auto it = std::upper_bound(runs.begin(), runs.end(), std::pair<uint16_t, uint16_t>(v, UINT16_MAX));
+    return it != runs.begin() && std::prev(it)->second >= v;
+  }
+}
+
+void compressed_bitset::container::insert(uint16_t v) {
+  if (type == kind::run) {
+    *this = from_words(to_words());
+  }
+  if (type == kind::bitmap) {
+    if (!test_bit(words, v)) {
+      words[bitset_utils::word_ind(v)] |= max_bit >> bitset_utils::offset(v);
+      ++cardinality;
+    }
+    return;
+  }
+  auto it = std::lower_bound(values.begin(), values.end(), v);
+  if (it != values.end() && *it == v) {
+    return;
+  }
+  values.insert(it, v);
+  if (++cardinality > array_max) {
+    *this = from_values(std::move(values));
+  }
+}
+
+void compressed_bitset::container::erase(uint16_t v) {
+  if (type == kind::run) {
+    *this = from_words(to_words());
+  }
+  if (type == kind::bitmap) {
+    if (test_bit(words, v)) {
+      words[bitset_utils::word_ind(v)] &= ~(max_bit >> bitset_utils::offset(v));
+      if (--cardinality <= array_max) {
+        *this = from_words(std::move(words));
+      }
+    }
+    return;
+  }
+  auto it = std::lower_bound(values.begin(), values.end(), v);
+  if (it != values.end() && *it == v) {
+    values.erase(it);
+    --cardinality;
+  }
+}
+
+std::size_t compressed_bitset::container::find_from(std::size_t v) const {
+  if (v >= chunk_bits) {
+    return chunk_bits;
+  }
+  switch (type) {
+  case kind::array: {
+    auto it = std::lower_bound(values.begin(), values.end(), v);
+    return it == values.end() ? chunk_bits : *it;
+  }
+  case kind::bitmap: {
+    std::size_t i = bitset_utils::word_ind(v);
+    word_type w = words[i] & (bitset_utils::mask >> bitset_utils::offset(v));
+    while (w == 0) {
+      if (++i == chunk_words) {
+        return chunk_bits;
+      }
+      w = words[i];
+    }
+    return i * bitset_utils::word_size + std::countl_zero(w);
+  }
+  default:
+    for (const auto& [first, last] : runs) {
+      if (last >= v) {
+        return std::max<std::size_t>(first, v);
+      }
+    }
+    return chunk_bits;
+  }
+}
+
+std::vector<compressed_bitset::word_type> compressed_bitset::container::to_words() const {
+  if (type == kind::bitmap) {
+    return words;
+  }
+  std::vector<word_type> res(chunk_words, 0);
+  if (type == kind::run) {
+    bitset_view<word_type> all(0, chunk_bits, res.data());
+    for (const auto& [first, last] : runs) {
+      all.subview(first, last - first + 1).set();
+    }
+    return res;
+  }
+  for (uint16_t v : values) {
+    res[bitset_utils::word_ind(v)] |= max_bit >> bitset_utils::offset(v);
+  }
+  return res;
+}
+
+compressed_bitset::const_view compressed_bitset::container::view(std::size_t bits) const {
+  return {0, bits, words.data()};
+}
+
+std::size_t compressed_bitset::container::bytes() const {
+  return sizeof(container) + values.capacity() * sizeof(uint16_t) + words.capacity() * sizeof(word_type) +
+         runs.capacity() * sizeof(runs[0]);
+}
+
+void compressed_bitset::container::optimize() {
+  std::vector<std::pair<uint16_t, uint16_t>> found;
+  for_each([&](std::size_t v) {
+    if (!found.empty() && found.back().second + 1u == v) {
+      found.back().second = v;
+    } else {
+      found.emplace_back(v, v);
+    }
+  });
+  std::size_t run_bytes = found.size() * sizeof(found[0]);
+  std::size_t plain_bytes = std::min(cardinality * sizeof(uint16_t), chunk_words * sizeof(word_type));
+  if (run_bytes < plain_bytes) {
+    if (type != kind::run) {
+      type = kind::run;
+      values = {};
+      words = {};
+      runs = std::move(found);
+    }
+  } else if (type == kind::run) {
+    *this = from_words(to_words());
+  }
+}
+
+template <typename F>
+void compressed_bitset::container::for_each(F f) const {
+  switch (type) {
+  case kind::array:
+    for (uint16_t v : values) {
+      f(v);
+    }
+    break;
+  case kind::bitmap:
+    for (std::size_t i = 0; i < chunk_words; ++i) {
+      for (word_type w = words[i]; w != 0; w &= ~(max_bit >> std::countl_zero(w))) {
+        f(i * bitset_utils::word_size + std::countl_zero(w));
+      }
+    }
+    break;
+  default:
+    for (const auto& [first, last] : runs) {
+      for (std::size_t v = first; v <= last; ++v) {
+        f(v);
+      }
+    }
+  }
+}
+
+// compressed_bitset
+
+compressed_bitset::compressed_bitset()
+    : _size(0) {}
+
+compressed_bitset::compressed_bitset(std::size_t size)
+    : _size(size) {}
+
+compressed_bitset::compressed_bitset(const const_view& other)
+    : _size(other.size()) {
+  for (std::size_t key = 0; key * chunk_bits < _size; ++key) {
+    const_view chunk = other.subview(key * chunk_bits, chunk_bits);
+    std::size_t cnt = chunk.count();
+    if (cnt == 0) {
+      continue;
+    }
+    if (cnt <= array_max) {
+      std::vector<uint16_t> values;
+      values.reserve(cnt);
+      for (std::size_t v : ones(chunk)) {
+        values.push_back(v);
+      }
+      _containers.push_back(container::from_values(std::move(values)));
+    } else {
+      std::vector<word_type> words(chunk_words, 0);
+      for (std::size_t i = 0; i < chunk.words_count(); ++i) {
+        words[i] = chunk.get_nth_word(i);
+      }
+      _containers.push_back(container::from_words(std::move(words)));
+    }
+    _keys.push_back(key);
+  }
+}
+
+compressed_bitset& compressed_bitset::operator=(const const_view& other) & {
+  compressed_bitset tmp(other);
+  swap(tmp);
+  return *this;
+}
+
+void compressed_bitset::swap(compressed_bitset& other) {
+  std::swap(_size, other._size);
+  std::swap(_keys, other._keys);
+  std::swap(_containers, other._containers);
+}
+
+bitset compressed_bitset::to_bitset() const {
+  bitset res(_size);
+  for (std::size_t i = 0; i < _keys.size(); ++i) {
+    std::size_t base = _keys[i] * chunk_bits;
+    bitset::view chunk = res.subview(base, chunk_size(_keys[i]));
+    const container& c = _containers[i];
+    if (c.type == container::kind::bitmap) {
+      chunk |= c.view(chunk.size());
+    } else if (c.type == container::kind::run) {
+      for (const auto& [first, last] : c.runs) {
+        chunk.subview(first, last - first + 1).set();
+      }
+    } else {
+      for (uint16_t v : c.values) {
+        chunk[v] = true;
+      }
+    }
+  }
+  return res;
+}
+
+std::size_t compressed_bitset::size() const {
+  return _size;
+}
+
+bool compressed_bitset::empty() const {
+  return _size == 0;
+}
+
+bool compressed_bitset::test(std::size_t pos) const {
+  std::size_t i = find_key(pos / chunk_bits);
+  return i != npos && _containers[i].contains(pos % chunk_bits);
+}
+
+bool compressed_bitset::operator[](std::size_t pos) const {
+  return test(pos);
+}
+
+compressed_bitset& compressed_bitset::set(std::size_t pos, bool value) & {
+  if (!value) {
+    return reset(pos);
+  }
+  uint32_t key = pos / chunk_bits;
+  auto it = std::lower_bound(_keys.begin(), _keys.end(), key);
+  std::size_t i = it - _keys.begin();
+  if (it == _keys.end() || *it != key) {
+    _keys.insert(it, key);
+    _containers.insert(_containers.begin() + i, container());
+  }
+  _containers[i].insert(pos % chunk_bits);
+  return *this;
+}
+
+compressed_bitset& compressed_bitset::reset(std::size_t pos) & {
+  std::size_t i = find_key(pos / chunk_bits);
+  if (i == npos) {
+    return *this;
+  }
+  _containers[i].erase(pos % chunk_bits);
+  if (_containers[i].cardinality == 0) {
+    _keys.erase(_keys.begin() + i);
+    _containers.erase(_containers.begin() + i);
+  }
+  return *this;
+}
+
+bool compressed_bitset::all() const {
+  return count() == _size;
+}
+
+bool compressed_bitset::any() const {
+  return !_containers.empty();
+}
+
+std::size_t compressed_bitset::count() const {
+  std::size_t res = 0;
+  for (const container& c : _containers) {
+    res += c.cardinality;
+  }
+  return res;
+}
+
+std::size_t compressed_bitset::find_first() const {
+  return _containers.empty() ? npos : _keys[0] * chunk_bits + _containers[0].find_from(0);
+}
+
+std::size_t compressed_bitset::find_next(std::size_t pos) const {
+  if (pos + 1 >= _size) {
+    return npos;
+  }
+  ++pos;
+  uint32_t key = pos / chunk_bits;
+  for (auto it = std::lower_bound(_keys.begin(), _keys.end(), key); it != _keys.end(); ++it) {
+    std::size_t from = *it == key ? pos % chunk_bits : 0;
+    std::size_t v = _containers[it - _keys.begin()].find_from(from);
+    if (v < chunk_bits) {
+      return *it * chunk_bits + v;
+    }
+  }
+  return npos;
+}
+
+compressed_bitset& compressed_bitset::operator&=(const compressed_bitset& other) & {
+  apply(other, op::bit_and);
+  return *this;
+}
+
+compressed_bitset& compressed_bitset::operator|=(const compressed_bitset& other) & {
+  apply(other, op::bit_or);
+  return *this;
+}
+
+compressed_bitset& compressed_bitset::operator^=(const compressed_bitset& other) & {
+  apply(other, op::bit_xor);
+  return *this;
+}
+
+compressed_bitset& compressed_bitset::operator&=(const const_view& other) & {
+  std::vector<uint32_t> keys;
+  std::vector<container> containers;
+  for (std::size_t i = 0; i < _keys.size(); ++i) {
+    const_view chunk = other.subview(_keys[i] * chunk_bits, chunk_size(_keys[i]));
+    const container& c = _containers[i];
+    container res;
+    if (c.type == container::kind::array) {
+      std::vector<uint16_t> values;
+      std::copy_if(c.values.begin(), c.values.end(), std::back_inserter(values), [&](uint16_t v) { return chunk[v]; });
+      res = container::from_values(std::move(values));
+    } else {
+      std::vector<word_type> words = c.to_words();
+      for (std::size_t j = 0; j < chunk.words_count(); ++j) {
+        words[j] &= chunk.get_nth_word(j);
+      }
+      res = container::from_words(std::move(words));
+    }
+    if (res.cardinality > 0) {
+      keys.push_back(_keys[i]);
+      containers.push_back(std::move(res));
+    }
+  }
+  _keys = std::move(keys);
+  _containers = std::move(containers);
+  return *this;
+}
+
+compressed_bitset& compressed_bitset::operator|=(const const_view& other) & {
+  return *this |= compressed_bitset(other);
+}
+
+compressed_bitset& compressed_bitset::operator^=(const const_view& other) & {
+  return *this ^= compressed_bitset(other);
+}
+
+compressed_bitset& compressed_bitset::run_optimize() & {
+  for (container& c : _containers) {
+    c.optimize();
+  }
+  return *this;
+}
+
+std::size_t compressed_bitset::memory_usage() const {
+  std::size_t res = _keys.capacity() * sizeof(uint32_t);
+  for (const container& c : _containers) {
+    res += c.bytes();
+  }
+  return res;
+}
+
+std::size_t compressed_bitset::chunk_size(std::size_t key) const {
+  return std::min(chunk_bits, _size - key * chunk_bits);
+}
+
+std::size_t compressed_bitset::find_key(uint32_t key) const {
+  auto it = std::lower_bound(_keys.begin(), _keys.end(), key);
+  return it != _keys.end() && *it == key ? it - _keys.begin() : npos;
+}
+
+void compressed_bitset::apply(const compressed_bitset& other, op o) {
+  std::vector<uint32_t> keys;
+  std::vector<container> containers;
+  auto push = [&](uint32_t key, container c) {
+    if (c.cardinality > 0) {
+      keys.push_back(key);
+      containers.push_back(std::move(c));
+    }
+  };
+  std::size_t i = 0;
+  std::size_t j = 0;
+  while (i < _keys.size() || j < other._keys.size()) {
+    if (j == other._keys.size() || (i < _keys.size() && _keys[i] < other._keys[j])) {
+      if (o != op::bit_and) {
+        push(_keys[i], std::move(_containers[i]));
+      }
+      ++i;
+    } else if (i == _keys.size() || other._keys[j] < _keys[i]) {
+      if (o != op::bit_and) {
+        push(other._keys[j], other._containers[j]);
+      }
+      ++j;
+    } else {
+      push(_keys[i], combine(_containers[i], other._containers[j], o));
+      ++i;
+      ++j;
+    }
+  }
+  _keys = std::move(keys);
+  _containers = std::move(containers);
+}
+
+compressed_bitset::container compressed_bitset::combine(const container& a, const container& b, op o) {
+  using kind = container::kind;
+  if (a.type == kind::array && b.type == kind::array) {
+    std::vector<uint16_t> values;
+    auto l = a.values.begin();
+    auto r = b.values.begin();
+    while (l != a.values.end() || r != b.values.end()) {
+      if (r == b.values.end() || (l != a.values.end() && *l < *r)) {
+        if (o != op::bit_and) {
+          values.push_back(*l);
+        }
+        ++l;
+      } else if (l == a.values.end() || *r < *l) {
+        if (o != op::bit_and) {
+          values.push_back(*r);
+        }
+        ++r;
+      } else {
+        if (o != op::bit_xor) {
+          values.push_back(*l);
+        }
+        ++l;
+        ++r;
+      }
+    }
+    return container::from_values(std::move(values));
+  }
+  if (o == op::bit_and && (a.type == kind::array || b.type == kind::array)) {
+    const container& small = a.type == kind::array ? a : b;
+    const container& other = a.type == kind::array ? b : a;
+    std::vector<uint16_t> values;
+    std::copy_if(small.values.begin(), small.values.end(), std::back_inserter(values), [&](uint16_t v) {
+      return other.contains(v);
+    });
+    return container::from_values(std::move(values));
+  }
+  std::vector<word_type> words = a.to_words();
+  std::vector<word_type> rhs = b.to_words();
+  for (std::size_t i = 0; i < chunk_words; ++i) {
+    switch (o) {
+    case op::bit_and:
+      words[i] &= rhs[i];
+      break;
+    case op::bit_or:
+      words[i] |= rhs[i];
+      break;
+    default:
+      words[i] ^= rhs[i];
+    }
+  }
+  return container::from_words(std::move(words));
+}
+
+bool operator==(const compressed_bitset& lhs, const compressed_bitset& rhs) {
+  if (lhs._size != rhs._size || lhs._keys != rhs._keys) {
+    return false;
+  }
+  for (std::size_t i = 0; i < lhs._containers.size(); ++i) {
+    const auto& l = lhs._containers[i];
+    const auto& r = rhs._containers[i];
+    if (l.cardinality != r.cardinality || l.to_words() != r.to_words()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool operator!=(const compressed_bitset& lhs, const compressed_bitset& rhs) {
+  return !(lhs == rhs);
+}
+
+bitset& operator&=(bitset& lhs, const compressed_bitset& rhs) {
+  std::size_t ci = 0;
+  for (std::size_t key = 0; key * compressed_bitset::chunk_bits < lhs.size(); ++key) {
+    bitset::view chunk = lhs.subview(key * compressed_bitset::chunk_bits, rhs.chunk_size(key));
+    if (ci == rhs._keys.size() || rhs._keys[ci] != key) {
+      chunk.reset();
+      continue;
+    }
+    const auto& c = rhs._containers[ci++];
+    if (c.type == compressed_bitset::container::kind::bitmap) {
+      chunk &= c.view(chunk.size());
+    } else {
+      std::vector<bitset::word_type> words = c.to_words();
+      chunk &= bitset::const_view(0, chunk.size(), words.data());
+    }
+  }
+  return lhs;
+}
+
+bitset& operator|=(bitset& lhs, const compressed_bitset& rhs) {
+  for (std::size_t i = 0; i < rhs._keys.size(); ++i) {
+    bitset::view chunk = lhs.subview(rhs._keys[i] * compressed_bitset::chunk_bits, rhs.chunk_size(rhs._keys[i]));
+    const auto& c = rhs._containers[i];
+    if (c.type == compressed_bitset::container::kind::bitmap) {
+      chunk |= c.view(chunk.size());
+    } else if (c.type == compressed_bitset::container::kind::run) {
+      for (const auto& [first, last] : c.runs) {
+        chunk.subview(first, last - first + 1).set();
+      }
+    } else {
+      for (uint16_t v : c.values) {
+        chunk[v] = true;
+      }
+    }
+  }
+  return lhs;
+}
+
+bitset& operator^=(bitset& lhs, const compressed_bitset& rhs) {
+  for (std::size_t i = 0; i < rhs._keys.size(); ++i) {
+    bitset::view chunk = lhs.subview(rhs._keys[i] * compressed_bitset::chunk_bits, rhs.chunk_size(rhs._keys[i]));
+    const auto& c = rhs._containers[i];
+    if (c.type == compressed_bitset::container::kind::bitmap) {
+      chunk ^= c.view(chunk.size());
+    } else if (c.type == compressed_bitset::container::kind::run) {
+      for (const auto& [first, last] : c.runs) {
+        chunk.subview(first, last - first + 1).flip();
+      }
+    } else {
+      for (uint16_t v : c.values) {
+        chunk[v].flip();
+      }
+    }
+  }
+  return lhs;
+}
+
+void swap(compressed_bitset& lhs, compressed_bitset& rhs) {
+  lhs.swap(rhs);
+}
+
+compressed_bitset operator&(const compressed_bitset& lhs, const compressed_bitset& rhs) {
+  compressed_bitset res(lhs);
+  res &= rhs;
+  return res;
+}
+
+compressed_bitset operator|(const compressed_bitset& lhs, const compressed_bitset& rhs) {
+  compressed_bitset res(lhs);
+  res |= rhs;
+  return res;
+}
+
+compressed_bitset operator^(const compressed_bitset& lhs, const compressed_bitset& rhs) {
+  compressed_bitset res(lhs);
+  res ^= rhs;
+  return res;
+}
+
+compressed_bitset operator&(const compressed_bitset& lhs, const bitset::const_view& rhs) {
+  compressed_bitset res(lhs);
+  res &= rhs;
+  return res;
+}
+
+compressed_bitset operator&(const bitset::const_view& lhs, const compressed_bitset& rhs) {
+  return rhs & lhs;
+}
+
+bitset operator|(const compressed_bitset& lhs, const bitset::const_view& rhs) {
+  bitset res(rhs);
+  res |= lhs;
+  return res;
+}
+
+bitset operator|(const bitset::const_view& lhs, const compressed_bitset& rhs) {
+  return rhs | lhs;
+}
+
+bitset operator^(const compressed_bitset& lhs, const bitset::const_view& rhs) {
+  bitset res(rhs);
+  res ^= lhs;
+  return res;
+}
+
+bitset operator^(const bitset::const_view& lhs, const compressed_bitset& rhs) {
+  return rhs ^ lhs;
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "bitset-utils.h"
+#include "bitset.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Roaring-style compressed bitset of a fixed size. Bits are split into chunks of 2^16, every
+// non-empty chunk is stored in the cheapest of three containers:
+// - array: sorted positions, used up to 4096 set bits;
+// - bitmap: 1024 words with the same layout as bitset, so it can be viewed as a const_view;
+// - run: sorted [first, last] intervals, chosen by run_optimize() for run-heavy chunks.
+// Empty chunks take no memory. As for bitset, binary operations are defined only for equal sizes.
+class compressed_bitset {
+public:
+  using word_type = bitset_utils::word_type;
+  using const_view = bitset::const_view;
+
+  static constexpr std::size_t npos = bitset_utils::npos;
+
+  compressed_bitset();
+  explicit compressed_bitset(std::size_t size);
+  explicit compressed_bitset(const const_view& other);
+
+  compressed_bitset& operator=(const const_view& other) &;
+
+  void swap(compressed_bitset& other);
+
+  bitset to_bitset() const;
+
+  std::size_t size() const;
+  bool empty() const;
+
+  bool test(std::size_t pos) const;
+  bool operator[](std::size_t pos) const;
+  compressed_bitset& set(std::size_t pos, bool value = true) &;
+  compressed_bitset& reset(std::size_t pos) &;
+
+  bool all() const;
+  bool any() const;
+  std::size_t count() const;
+
+  std::size_t find_first() const;
+  std::size_t find_next(std::size_t pos) const;
+
+  compressed_bitset& operator&=(const compressed_bitset& other) &;
+  compressed_bitset& operator|=(const compressed_bitset& other) &;
+  compressed_bitset& operator^=(const compressed_bitset& other) &;
+
+  compressed_bitset& operator&=(const const_view& other) &;
+  compressed_bitset& operator|=(const const_view& other) &;
+  compressed_bitset& operator^=(const const_view& other) &;
+
+  // Converts chunks to run containers where it makes them smaller, and back
+  compressed_bitset& run_optimize() &;
+
+  // Bytes used by the containers
+  std::size_t memory_usage() const;
+
+  friend bool operator==(const compressed_bitset& lhs, const compressed_bitset& rhs);
+  friend bool operator!=(const compressed_bitset& lhs, const compressed_bitset& rhs);
+
+  friend bitset& operator&=(bitset& lhs, const compressed_bitset& rhs);
+  friend bitset& operator|=(bitset& lhs, const compressed_bitset& rhs);
+  friend bitset& operator^=(bitset& lhs, const compressed_bitset& rhs);
+
+private:
+  static constexpr std::size_t chunk_bits = std::size_t(1) << 16;
+  static constexpr std::size_t chunk_words = chunk_bits / bitset_utils::word_size;
+  static constexpr std::size_t array_max = 4096;
+
+  enum class op { bit_and, bit_or, bit_xor };
+
+  struct container {
+    enum class kind { array, bitmap, run };
+
+    kind type = kind::array;
+    std::size_t cardinality = 0;
+    std::vector<uint16_t> values;
+    std::vector<word_type> words;
+    std::vector<std::pair<uint16_t, uint16_t>> runs;
+
+    static container from_values(std::vector<uint16_t> values);
+    static container from_words(std::vector<word_type> words);
+
+    bool contains(uint16_t v) const;
+    void insert(uint16_t v);
+    void erase(uint16_t v);
+    std::size_t find_from(std::size_t v) const;
+    std::vector<word_type> to_words() const;
+    const_view view(std::size_t bits) const;
+    std::size_t bytes() const;
+    void optimize();
+
+    template <typename F>
+    void for_each(F f) const;
+  };
+
+  std::size_t _size;
+  std::vector<uint32_t> _keys;
+  std::vector<container> _containers;
+
+  std::size_t chunk_size(std::size_t key) const;
+  std::size_t find_key(uint32_t key) const;
+  void apply(const compressed_bitset& other, op o);
+  static container combine(const container& a, const container& b, op o);
+};
+
+void swap(compressed_bitset& lhs, compressed_bitset& rhs);
+
+compressed_bitset operator&(const compressed_bitset& lhs, const compressed_bitset& rhs);
+compressed_bitset operator|(const compressed_bitset& lhs, const compressed_bitset& rhs);
+compressed_bitset operator^(const compressed_bitset& lhs, const compressed_bitset& rhs);
+
+// Mixed operations keep the representation that fits the result: the intersection with a dense
+// view is at most as large as the compressed operand, union and difference are dense
+compressed_bitset operator&(const compressed_bitset& lhs, const bitset::const_view& rhs);
+compressed_bitset operator&(const bitset::const_view& lhs, const compressed_bitset& rhs);
+bitset operator|(const compressed_bitset& lhs, const bitset::const_view& rhs);
+bitset operator|(const bitset::const_view& lhs, const compressed_bitset& rhs);
+bitset operator^(const compressed_bitset& lhs, const bitset::const_view& rhs);
+bitset operator^(const bitset::const_view& lhs, const compressed_bitset& rhs);
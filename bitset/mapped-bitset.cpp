@@ -0,0 +1,218 @@
+#include "mapped-bitset.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+std::size_t words_for(std::size_t size) {
+  return size / bitset_utils::word_size + (size % bitset_utils::word_size > 0);
+}
+
+[[noreturn]] void throw_errno(const std::string& what) {
+  throw std::system_error(errno, std::generic_category(), what);
+}
+
+[[noreturn]] void throw_format(const std::string& path, const char* what) {
+  throw std::system_error(std::make_error_code(std::errc::invalid_argument), path + ": " + what);
+}
+
+// Closes the descriptor once the mapping is made or on error
+class file_descriptor {
+public:
+  explicit file_descriptor(int fd)
+      : _fd(fd) {}
+
+  file_descriptor(const file_descriptor&) = delete;
+  file_descriptor& operator=(const file_descriptor&) = delete;
+
+  ~file_descriptor() {
+    ::close(_fd);
+  }
+
+  int get() const {
+    return _fd;
+  }
+
+private:
+  int _fd;
+};
+} // namespace
+
+mapped_bitset::mapped_bitset(word_type* data, std::size_t size)
+    : _size(size)
+    , _data(data)
+    , _writable(true) {}
+
+mapped_bitset::mapped_bitset(const word_type* data, std::size_t size)
+    : _size(size)
+    , _data(const_cast<word_type*>(data))
+    , _writable(false) {}
+
+mapped_bitset::mapped_bitset(mapped_bitset&& other) noexcept {
+  swap(other);
+}
+
+mapped_bitset& mapped_bitset::operator=(mapped_bitset&& other) noexcept {
+  mapped_bitset tmp(std::move(other));
+  swap(tmp);
+  return *this;
+}
+
+mapped_bitset::~mapped_bitset() {
+  if (_mapping != nullptr) {
+    ::munmap(_mapping, _mapping_size);
+  }
+}
+
+mapped_bitset mapped_bitset::map(const std::string& path, int fd, std::size_t bytes, bool writable) {
+  int prot = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+  void* mapping = ::mmap(nullptr, bytes, prot, MAP_SHARED, fd, 0);
+  if (mapping == MAP_FAILED) {
+    throw_errno("mmap " + path);
+  }
+  mapped_bitset res;
+  res._mapping = mapping;
+  res._mapping_size = bytes;
+  res._writable = writable;
+  res._data = reinterpret_cast<word_type*>(static_cast<char*>(mapping) + sizeof(mapped_bitset_header));
+  return res;
+}
+
+mapped_bitset mapped_bitset::create(const std::string& path, std::size_t size, bool value) {
+  file_descriptor fd(::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644));
+  if (fd.get() < 0) {
+    throw_errno("open " + path);
+  }
+  std::size_t bytes = sizeof(mapped_bitset_header) + words_for(size) * sizeof(word_type);
+  // The file is extended with zeros, so the words start out cleared
+  if (::ftruncate(fd.get(), static_cast<off_t>(bytes)) != 0) {
+    throw_errno("ftruncate " + path);
+  }
+
+  mapped_bitset res = map(path, fd.get(), bytes, true);
+  res._size = size;
+  mapped_bitset_header header{};
+  std::memcpy(header.magic, mapped_bitset_header::magic_value, sizeof(header.magic));
+  header.version = mapped_bitset_header::current_version;
+  header.word_bits = bitset_utils::word_size;
+  header.byte_order = mapped_bitset_header::byte_order_mark;
+  header.size = size;
+  std::memcpy(res._mapping, &header, sizeof(header));
+  if (value) {
+    res.subview().set();
+  }
+  return res;
+}
+
+mapped_bitset mapped_bitset::open(const std::string& path, mode m) {
+  bool writable = m == mode::read_write;
+  file_descriptor fd(::open(path.c_str(), (writable ? O_RDWR : O_RDONLY) | O_CLOEXEC));
+  if (fd.get() < 0) {
+    throw_errno("open " + path);
+  }
+  struct stat st;
+  if (::fstat(fd.get(), &st) != 0) {
+    throw_errno("stat " + path);
+  }
+  std::size_t bytes = static_cast<std::size_t>(st.st_size);
+  if (bytes < sizeof(mapped_bitset_header)) {
+    throw_format(path, "file is too short for a bitset header");
+  }
+
+  mapped_bitset res = map(path, fd.get(), bytes, writable);
+  mapped_bitset_header header;
+  std::memcpy(&header, res._mapping, sizeof(header));
+  if (std::memcmp(header.magic, mapped_bitset_header::magic_value, sizeof(header.magic)) != 0) {
+    throw_format(path, "not a bitset file");
+  }
+  if (header.byte_order != mapped_bitset_header::byte_order_mark) {
+    throw std::system_error(std::make_error_code(std::errc::not_supported), path + ": foreign byte order");
+  }
+  if (header.version != mapped_bitset_header::current_version || header.word_bits != bitset_utils::word_size) {
+    throw std::system_error(std::make_error_code(std::errc::not_supported), path + ": unsupported version");
+  }
+  if ((bytes - sizeof(header)) / sizeof(word_type) < words_for(header.size)) {
+    throw_format(path, "file is shorter than its bitset");
+  }
+  res._size = header.size;
+  return res;
+}
+
+void mapped_bitset::save(const std::string& path, const const_view& bs) {
+  mapped_bitset res = create(path, bs.size());
+  for (std::size_t i = 0; i < res.word_cnt(); ++i) {
+    res._data[i] = bs.get_nth_word(i);
+  }
+  res.flush();
+}
+
+void mapped_bitset::swap(mapped_bitset& other) noexcept {
+  std::swap(_size, other._size);
+  std::swap(_data, other._data);
+  std::swap(_writable, other._writable);
+  std::swap(_mapping, other._mapping);
+  std::swap(_mapping_size, other._mapping_size);
+}
+
+std::size_t mapped_bitset::size() const {
+  return _size;
+}
+
+std::size_t mapped_bitset::word_cnt() const {
+  return words_for(size());
+}
+
+bool mapped_bitset::empty() const {
+  return size() == 0;
+}
+
+bool mapped_bitset::writable() const {
+  return _writable;
+}
+
+mapped_bitset::word_type* mapped_bitset::data() {
+  if (!_writable) {
+    throw std::system_error(std::make_error_code(std::errc::read_only_file_system), "bitset is read-only");
+  }
+  return _data;
+}
+
+const mapped_bitset::word_type* mapped_bitset::data() const {
+  return _data;
+}
+
+void mapped_bitset::flush() {
+  if (_mapping != nullptr && _writable && ::msync(_mapping, _mapping_size, MS_SYNC) != 0) {
+    throw_errno("msync");
+  }
+}
+
+mapped_bitset::operator const_view() const {
+  return {0, size(), data()};
+}
+
+mapped_bitset::operator view() {
+  return {0, size(), data()};
+}
+
+mapped_bitset::view mapped_bitset::subview(std::size_t offset, std::size_t count) {
+  return view(*this).subview(offset, count);
+}
+
+mapped_bitset::const_view mapped_bitset::subview(std::size_t offset, std::size_t count) const {
+  return const_view(*this).subview(offset, count);
+}
+
+void swap(mapped_bitset& lhs, mapped_bitset& rhs) noexcept {
+  lhs.swap(rhs);
+}
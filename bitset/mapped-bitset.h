@@ -0,0 +1,90 @@
+#pragma once
+
+#include "bitset-utils.h"
+#include "bitset.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// File layout of a mapped bitset: this header, then word_cnt() words right after it. Words keep the
+// in-memory bitset layout (bit i is bit 63 - i % 64 of word i / 64) in the byte order of the writer,
+// recorded in byte_order. Bits of the last word past size are 0.
+struct mapped_bitset_header {
+  static constexpr char magic_value[8] = {'B', 'I', 'T', 'S', 'E', 'T', '\0', '\0'};
+  static constexpr uint32_t current_version = 1;
+  static constexpr uint64_t byte_order_mark = 0x0102030405060708;
+
+  char magic[8];
+  uint32_t version;
+  uint32_t word_bits;
+  uint64_t byte_order;
+  uint64_t size;
+  uint8_t reserved[32];
+};
+
+static_assert(sizeof(mapped_bitset_header) == 64);
+
+// Fixed-size bitset over memory it does not allocate: either a shared mapping of a file in the
+// format above or a buffer owned by the caller. Changes to a writable mapping go to the file.
+// Errors are reported with std::system_error.
+class mapped_bitset {
+public:
+  using word_type = bitset_utils::word_type;
+  using view = bitset::view;
+  using const_view = bitset::const_view;
+
+  enum class mode { read_only, read_write };
+
+  static constexpr std::size_t npos = bitset_utils::npos;
+
+  // Caller buffers of at least (size + 63) / 64 words, they must outlive the bitset
+  mapped_bitset(word_type* data, std::size_t size);
+  mapped_bitset(const word_type* data, std::size_t size);
+
+  mapped_bitset(mapped_bitset&& other) noexcept;
+  mapped_bitset& operator=(mapped_bitset&& other) noexcept;
+
+  ~mapped_bitset();
+
+  // Creates or truncates the file and maps it for writing
+  static mapped_bitset create(const std::string& path, std::size_t size, bool value = false);
+  static mapped_bitset open(const std::string& path, mode m = mode::read_only);
+
+  // Writes bs to path in the mapped format
+  static void save(const std::string& path, const const_view& bs);
+
+  void swap(mapped_bitset& other) noexcept;
+
+  std::size_t size() const;
+  std::size_t word_cnt() const;
+  bool empty() const;
+  bool writable() const;
+
+  // Throws if the bitset is read-only
+  word_type* data();
+  const word_type* data() const;
+
+  // Writes dirty pages of a file mapping back to disk, no-op for caller buffers
+  void flush();
+
+  operator const_view() const;
+  // Throws if the bitset is read-only
+  operator view();
+
+  view subview(std::size_t offset = 0, std::size_t count = npos);
+  const_view subview(std::size_t offset = 0, std::size_t count = npos) const;
+
+private:
+  std::size_t _size = 0;
+  word_type* _data = nullptr;
+  bool _writable = false;
+  void* _mapping = nullptr;
+  std::size_t _mapping_size = 0;
+
+  mapped_bitset() = default;
+
+  static mapped_bitset map(const std::string& path, int fd, std::size_t bytes, bool writable);
+};
+
+void swap(mapped_bitset& lhs, mapped_bitset& rhs) noexcept;
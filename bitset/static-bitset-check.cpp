@@ -0,0 +1,37 @@
+// Compile-time checks of the static_bitset constructors. There is nothing to run, compile it:
+//   g++ -std=c++20 -Wall -Wextra -fsyntax-only static-bitset-check.cpp
+
+#include "static-bitset.h"
+
+#include <string_view>
+#include <type_traits>
+
+// Integers, 0 included, pick the value constructor
+static_assert(static_bitset<8>(0) == static_bitset<8>());
+static_assert(static_bitset<8>(0u) == static_bitset<8>());
+static_assert(static_bitset<8>(0ull) == static_bitset<8>());
+static_assert(static_bitset<8>(5).test(0) && !static_bitset<8>(5).test(1) && static_bitset<8>(5).test(2));
+static_assert(static_bitset<8>(5).count() == 2);
+static_assert(static_bitset<128>(1).test(0) && static_bitset<128>(1).count() == 1);
+
+// Bits of the value past N are dropped
+static_assert(static_bitset<4>(0xff) == static_bitset<4>(0xf));
+static_assert(static_bitset<4>(0xff).all());
+
+// Over 64 bits the value fills the first word only
+static_assert(static_bitset<100>(~0ull).count() == 64);
+static_assert(!static_bitset<100>(~0ull).test(64));
+
+// bool still sets or clears every bit
+static_assert(static_bitset<70>(true).all());
+static_assert(!static_bitset<70>(false).any());
+
+// Strings, bit i is character i
+static_assert(static_bitset<4>("1010") == static_bitset<4>(5));
+static_assert(static_bitset<4>(std::string_view("0110")) == static_bitset<4>(6));
+static_assert(static_bitset<8>("1").count() == 1);
+
+// No implicit conversions
+static_assert(!std::is_convertible_v<int, static_bitset<8>>);
+static_assert(!std::is_convertible_v<bool, static_bitset<8>>);
+static_assert(!std::is_convertible_v<const char*, static_bitset<8>>);
@@ -0,0 +1,300 @@
+#pragma once
+
+#include "bitset-utils.h"
+#include "bitset.h"
+
+#include <array>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <utility>
+
+// Bitset of N bits stored inline. Word count and tail mask are compile-time constants, operations
+// are constexpr and their word loops are fully unrolled. Bits past N are always 0. Converts to
+// bitset::view and bitset::const_view, so the generic algorithms work on it as well.
+template <std::size_t N>
+class static_bitset {
+public:
+  using word_type = bitset_utils::word_type;
+  using value_type = bool;
+  using reference = bitset::reference;
+  using const_reference = bitset::const_reference;
+  using iterator = bitset::iterator;
+  using const_iterator = bitset::const_iterator;
+  using view = bitset::view;
+  using const_view = bitset::const_view;
+
+  static constexpr std::size_t words = bitset_utils::word_ind(N) + (bitset_utils::offset(N) > 0);
+
+  constexpr static_bitset() = default;
+
+  // Every bit set to value. A template, so that integers pick the constructor below.
+  template <std::same_as<bool> B>
+  constexpr explicit static_bitset(B value) {
+    if (value) {
+      set();
+    }
+  }
+
+  // Bit i is bit i of value, like std::bitset(unsigned long long)
+  constexpr explicit static_bitset(unsigned long long value) {
+    for (std::size_t i = 0; i < N && i < std::numeric_limits<unsigned long long>::digits; ++i) {
+      set(i, (value >> i) & 1);
+    }
+  }
+
+  constexpr explicit static_bitset(std::string_view str) {
+    for (std::size_t i = 0; i < N && i < str.size(); ++i) {
+      set(i, str[i] == '1');
+    }
+  }
+
+  // Without it a string literal would pick the bool constructor. A template, so that a literal 0 is
+  // an integer rather than a null string.
+  template <std::same_as<char> C>
+  constexpr explicit static_bitset(const C* str) : static_bitset(std::string_view(str)) {}
+
+  // Copies the first N bits of other, the rest stays 0
+  explicit static_bitset(const const_view& other) {
+    const_view head = other.subview(0, N);
+    for (std::size_t i = 0; i < head.words_count(); ++i) {
+      _words[i] = head.get_nth_word(i);
+    }
+  }
+
+  static constexpr std::size_t size() {
+    return N;
+  }
+
+  static constexpr bool empty() {
+    return N == 0;
+  }
+
+  constexpr word_type* data() {
+    return _words.data();
+  }
+
+  constexpr const word_type* data() const {
+    return _words.data();
+  }
+
+  constexpr bool test(std::size_t pos) const {
+    return _words[bitset_utils::word_ind(pos)] & bit(pos);
+  }
+
+  constexpr static_bitset& set(std::size_t pos, bool value = true) {
+    if (value) {
+      _words[bitset_utils::word_ind(pos)] |= bit(pos);
+    } else {
+      _words[bitset_utils::word_ind(pos)] &= ~bit(pos);
+    }
+    return *this;
+  }
+
+  constexpr static_bitset& reset(std::size_t pos) {
+    return set(pos, false);
+  }
+
+  constexpr static_bitset& flip(std::size_t pos) {
+    _words[bitset_utils::word_ind(pos)] ^= bit(pos);
+    return *this;
+  }
+
+  reference operator[](std::size_t pos) {
+    return {bitset_utils::offset(pos), data() + bitset_utils::word_ind(pos)};
+  }
+
+  const_reference operator[](std::size_t pos) const {
+    return {bitset_utils::offset(pos), data() + bitset_utils::word_ind(pos)};
+  }
+
+  iterator begin() {
+    return {0, data()};
+  }
+
+  const_iterator begin() const {
+    return {0, data()};
+  }
+
+  iterator end() {
+    return {N, data()};
+  }
+
+  const_iterator end() const {
+    return {N, data()};
+  }
+
+  constexpr static_bitset& set() {
+    for_each_word([&](std::size_t i) { _words[i] = bitset_utils::mask; });
+    trim();
+    return *this;
+  }
+
+  constexpr static_bitset& reset() {
+    for_each_word([&](std::size_t i) { _words[i] = 0; });
+    return *this;
+  }
+
+  constexpr static_bitset& flip() {
+    for_each_word([&](std::size_t i) { _words[i] = ~_words[i]; });
+    trim();
+    return *this;
+  }
+
+  constexpr static_bitset& operator&=(const static_bitset& other) {
+    for_each_word([&](std::size_t i) { _words[i] &= other._words[i]; });
+    return *this;
+  }
+
+  constexpr static_bitset& operator|=(const static_bitset& other) {
+    for_each_word([&](std::size_t i) { _words[i] |= other._words[i]; });
+    return *this;
+  }
+
+  constexpr static_bitset& operator^=(const static_bitset& other) {
+    for_each_word([&](std::size_t i) { _words[i] ^= other._words[i]; });
+    return *this;
+  }
+
+  // Same meaning as bitset_view::shift_left and bitset_view::shift_right
+  constexpr static_bitset& shift_left(std::size_t count) {
+    if (count >= N) {
+      return reset();
+    }
+    std::size_t q = bitset_utils::word_ind(count);
+    std::size_t s = bitset_utils::offset(count);
+    for_each_word([&](std::size_t i) {
+      word_type w = word_or_zero(i + q) << s;
+      if (s > 0) {
+        w |= word_or_zero(i + q + 1) >> (bitset_utils::word_size - s);
+      }
+      _words[i] = w;
+    });
+    return *this;
+  }
+
+  constexpr static_bitset& shift_right(std::size_t count) {
+    if (count >= N) {
+      return reset();
+    }
+    std::size_t q = bitset_utils::word_ind(count);
+    std::size_t s = bitset_utils::offset(count);
+    for_each_word_reversed([&](std::size_t i) {
+      word_type w = i >= q ? _words[i - q] >> s : 0;
+      if (s > 0 && i > q) {
+        w |= _words[i - q - 1] << (bitset_utils::word_size - s);
+      }
+      _words[i] = w;
+    });
+    trim();
+    return *this;
+  }
+
+  constexpr std::size_t count() const {
+    std::size_t res = 0;
+    for_each_word([&](std::size_t i) { res += std::popcount(_words[i]); });
+    return res;
+  }
+
+  constexpr bool any() const {
+    word_type acc = 0;
+    for_each_word([&](std::size_t i) { acc |= _words[i]; });
+    return acc != 0;
+  }
+
+  constexpr bool none() const {
+    return !any();
+  }
+
+  constexpr bool all() const {
+    bool res = true;
+    for_each_word([&](std::size_t i) { res &= _words[i] == (i + 1 == words ? tail_mask : bitset_utils::mask); });
+    return res;
+  }
+
+  operator view() {
+    return {0, N, data()};
+  }
+
+  operator const_view() const {
+    return {0, N, data()};
+  }
+
+  view subview(std::size_t offset = 0, std::size_t count = bitset::npos) {
+    return view(*this).subview(offset, count);
+  }
+
+  const_view subview(std::size_t offset = 0, std::size_t count = bitset::npos) const {
+    return const_view(*this).subview(offset, count);
+  }
+
+  constexpr void swap(static_bitset& other) {
+    std::swap(_words, other._words);
+  }
+
+  friend constexpr void swap(static_bitset& lhs, static_bitset& rhs) {
+    lhs.swap(rhs);
+  }
+
+  friend constexpr bool operator==(const static_bitset& lhs, const static_bitset& rhs) {
+    return lhs._words == rhs._words;
+  }
+
+  friend constexpr bool operator!=(const static_bitset& lhs, const static_bitset& rhs) {
+    return !(lhs == rhs);
+  }
+
+  friend constexpr static_bitset operator&(static_bitset lhs, const static_bitset& rhs) {
+    return lhs &= rhs;
+  }
+
+  friend constexpr static_bitset operator|(static_bitset lhs, const static_bitset& rhs) {
+    return lhs |= rhs;
+  }
+
+  friend constexpr static_bitset operator^(static_bitset lhs, const static_bitset& rhs) {
+    return lhs ^= rhs;
+  }
+
+  friend constexpr static_bitset operator~(static_bitset bs) {
+    return bs.flip();
+  }
+
+  friend std::string to_string(const static_bitset& bs) {
+    return to_string(const_view(bs));
+  }
+
+private:
+  static constexpr word_type tail_mask =
+      bitset_utils::offset(N) > 0 ? bitset_utils::mask << (bitset_utils::word_size - bitset_utils::offset(N))
+                                  : bitset_utils::mask;
+
+  std::array<word_type, words> _words{};
+
+  static constexpr word_type bit(std::size_t pos) {
+    return (word_type(1) << (bitset_utils::word_size - 1)) >> bitset_utils::offset(pos);
+  }
+
+  template <typename F>
+  static constexpr void for_each_word(F f) {
+    [&]<std::size_t... I>(std::index_sequence<I...>) { (f(I), ...); }(std::make_index_sequence<words>());
+  }
+
+  template <typename F>
+  static constexpr void for_each_word_reversed(F f) {
+    [&]<std::size_t... I>(std::index_sequence<I...>) { (f(words - 1 - I), ...); }(std::make_index_sequence<words>());
+  }
+
+  constexpr word_type word_or_zero(std::size_t i) const {
+    return i < words ? _words[i] : 0;
+  }
+
+  constexpr void trim() {
+    if constexpr (words > 0) {
+      _words[words - 1] &= tail_mask;
+    }
+  }
+};
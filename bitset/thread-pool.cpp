@@ -0,0 +1,90 @@
+#include "thread-pool.h"
+
+#include <cstddef>
+#include <functional>
+#include <mutex>
+
+namespace {
+// Set while the thread runs a task
+thread_local bool inside_task = false;
+} // namespace
+
+thread_pool::thread_pool(std::size_t threads)
+    : _task(nullptr)
+    , _count(0)
+    , _next(0)
+    , _running(0)
+    , _generation(0)
+    , _stop(false) {
+  for (std::size_t i = 1; i < threads; ++i) {
+    _workers.emplace_back([this] { work(); });
+  }
+}
+
+thread_pool::~thread_pool() {
+  {
+    std::lock_guard lock(_mutex);
+    _stop = true;
+  }
+  _wake.notify_all();
+  for (std::thread& worker : _workers) {
+    worker.join();
+  }
+}
+
+std::size_t thread_pool::size() const {
+  return _workers.size() + 1;
+}
+
+void thread_pool::run(std::size_t count, const std::function<void(std::size_t)>& task) {
+  if (count == 0) {
+    return;
+  }
+  // the caller holds a slot of a running job, so waiting for the pool could deadlock
+  if (inside_task) {
+    for (std::size_t i = 0; i < count; ++i) {
+      task(i);
+    }
+    return;
+  }
+  std::lock_guard run_lock(_run_mutex);
+  std::unique_lock lock(_mutex);
+  _task = &task;
+  _count = count;
+  _next = 0;
+  ++_generation;
+  _wake.notify_all();
+  drain(lock);
+  _done.wait(lock, [this] { return _next == _count && _running == 0; });
+  _task = nullptr;
+}
+
+void thread_pool::work() {
+  std::size_t seen = 0;
+  std::unique_lock lock(_mutex);
+  while (true) {
+    _wake.wait(lock, [&] { return _stop || _generation != seen; });
+    if (_stop) {
+      return;
+    }
+    seen = _generation;
+    drain(lock);
+  }
+}
+
+void thread_pool::drain(std::unique_lock<std::mutex>& lock) {
+  while (_task && _next < _count) {
+    std::size_t i = _next++;
+    const std::function<void(std::size_t)>& task = *_task;
+    ++_running;
+    lock.unlock();
+    inside_task = true;
+    task(i);
+    inside_task = false;
+    lock.lock();
+    --_running;
+  }
+  if (_running == 0) {
+    _done.notify_all();
+  }
+}
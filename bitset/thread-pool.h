@@ -0,0 +1,43 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads that run one indexed job at a time
+class thread_pool {
+public:
+  explicit thread_pool(std::size_t threads = std::thread::hardware_concurrency());
+
+  thread_pool(const thread_pool& other) = delete;
+  thread_pool& operator=(const thread_pool& other) = delete;
+
+  ~thread_pool();
+
+  // Number of threads taking part in run(), including the calling one
+  std::size_t size() const;
+
+  // Calls task(i) for every i in [0, count) on the workers and the calling thread, returns once all
+  // calls have finished. Concurrent run() calls are serialized, a run() from inside a task of any
+  // pool calls task(i) in order on the current thread instead of waiting for the workers.
+  void run(std::size_t count, const std::function<void(std::size_t)>& task);
+
+private:
+  std::vector<std::thread> _workers;
+  std::mutex _run_mutex;
+  std::mutex _mutex;
+  std::condition_variable _wake;
+  std::condition_variable _done;
+  const std::function<void(std::size_t)>* _task;
+  std::size_t _count;
+  std::size_t _next;
+  std::size_t _running;
+  std::size_t _generation;
+  bool _stop;
+
+  void work();
+  void drain(std::unique_lock<std::mutex>& lock);
+};
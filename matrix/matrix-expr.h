@@ -0,0 +1,512 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <concepts>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include "matrix-simd.h"
+#include "thread-pool.h"
+
+template <class T>
+class matrix;
+
+template <class T>
+class matrix_view;
+
+template <class T, size_t Rows, size_t Cols>
+class static_matrix;
+
+// Lazy matrix arithmetic. `A + B - 2 * C` builds a tree of nodes that refer to the operands and is
+// computed element by element in a single pass when it is assigned to a matrix. Products are
+// computed with the GEMM engine: `A * B + C` writes C and lets the product accumulate into it, a
+// product nested deeper is computed once into a temporary before the pass. An expression must not
+// outlive the matrices it refers to.
+namespace matrix_expr {
+template <class D>
+class expression {
+public:
+  size_t size() const {
+    return self().rows() * self().cols();
+  }
+
+  bool empty() const {
+    return size() == 0;
+  }
+
+  auto operator()(size_t row, size_t col) const {
+    assert(row < self().rows() && col < self().cols());
+    return self().value(row, col);
+  }
+
+private:
+  const D& self() const {
+    return static_cast<const D&>(*this);
+  }
+};
+
+// Node interface: value_type, rows(), cols(), value(row, col), prepare() to compute nested products
+// before value() is used in bulk, and aliases(dst, stride) telling whether evaluating the node into
+// the destination with this data and row stride would read elements it has already overwritten.
+template <class E>
+concept node = std::derived_from<E, expression<E>>;
+
+template <class M>
+struct is_matrix : std::false_type {};
+
+template <class T>
+struct is_matrix<matrix<T>> : std::true_type {};
+
+template <class T>
+struct is_matrix<matrix_view<T>> : std::true_type {};
+
+template <class T, size_t Rows, size_t Cols>
+struct is_matrix<static_matrix<T, Rows, Cols>> : std::true_type {};
+
+template <class E>
+concept operand = node<E> || is_matrix<E>::value;
+
+// Whether two strided blocks of rows x cols elements share any address
+template <class T>
+bool overlap(const T* a, size_t a_stride, const T* b, size_t b_stride, size_t rows, size_t cols) {
+  if (rows == 0 || cols == 0) {
+    return false;
+  }
+  std::less<const T*> less;
+  return less(a, b + (rows - 1) * b_stride + cols) && less(b, a + (rows - 1) * a_stride + cols);
+}
+
+template <class T>
+class leaf : public expression<leaf<T>> {
+public:
+  using value_type = T;
+
+  leaf(const T* data, size_t rows, size_t cols, size_t stride)
+      : _data(data), _rows(rows), _cols(cols), _stride(stride) {}
+
+  size_t rows() const {
+    return _rows;
+  }
+
+  size_t cols() const {
+    return _cols;
+  }
+
+  T value(size_t row, size_t col) const {
+    return _data[row * _stride + col];
+  }
+
+  const T* row(size_t row) const {
+    return _data + row * _stride;
+  }
+
+  void prepare() const {}
+
+  // Rows follow each other without gaps
+  bool contiguous() const {
+    return _stride == _cols;
+  }
+
+  // Reading the very element that is written is fine, any other overlap is not
+  bool aliases(const T* dst, size_t stride) const {
+    return !(dst == _data && stride == _stride) && overlap(_data, _stride, dst, stride, _rows, _cols);
+  }
+
+private:
+  const T* _data;
+  size_t _rows;
+  size_t _cols;
+  size_t _stride;
+};
+
+template <class T>
+leaf<T> wrap(const matrix<T>& m) {
+  return {m.data(), m.rows(), m.cols(), m.stride()};
+}
+
+template <class T>
+leaf<std::remove_const_t<T>> wrap(const matrix_view<T>& v) {
+  return {v.data(), v.rows(), v.cols(), v.stride()};
+}
+
+template <class T, size_t Rows, size_t Cols>
+leaf<T> wrap(const static_matrix<T, Rows, Cols>& m) {
+  return {m.data(), Rows, Cols, Cols};
+}
+
+template <node E>
+const E& wrap(const E& e) {
+  return e;
+}
+
+template <class E>
+using node_t = std::decay_t<decltype(wrap(std::declval<const E&>()))>;
+
+template <class E>
+using value_t = typename node_t<E>::value_type;
+
+template <class Op, class L, class R>
+class binary_node : public expression<binary_node<Op, L, R>> {
+public:
+  using value_type = typename L::value_type;
+
+  binary_node(const L& left, const R& right) : _left(left), _right(right) {
+    assert(left.rows() == right.rows() && left.cols() == right.cols());
+  }
+
+  size_t rows() const {
+    return _left.rows();
+  }
+
+  size_t cols() const {
+    return _left.cols();
+  }
+
+  value_type value(size_t row, size_t col) const {
+    return Op()(_left.value(row, col), _right.value(row, col));
+  }
+
+  void prepare() const {
+    _left.prepare();
+    _right.prepare();
+  }
+
+  bool aliases(const value_type* dst, size_t stride) const {
+    return _left.aliases(dst, stride) || _right.aliases(dst, stride);
+  }
+
+  const L& left() const {
+    return _left;
+  }
+
+  const R& right() const {
+    return _right;
+  }
+
+private:
+  L _left;
+  R _right;
+};
+
+template <class E>
+class scale_node : public expression<scale_node<E>> {
+public:
+  using value_type = typename E::value_type;
+
+  scale_node(const E& e, const value_type& factor) : _e(e), _factor(factor) {}
+
+  size_t rows() const {
+    return _e.rows();
+  }
+
+  size_t cols() const {
+    return _e.cols();
+  }
+
+  value_type value(size_t row, size_t col) const {
+    return _e.value(row, col) * _factor;
+  }
+
+  void prepare() const {
+    _e.prepare();
+  }
+
+  bool aliases(const value_type* dst, size_t stride) const {
+    return _e.aliases(dst, stride);
+  }
+
+  const E& operand() const {
+    return _e;
+  }
+
+  const value_type& factor() const {
+    return _factor;
+  }
+
+private:
+  E _e;
+  value_type _factor;
+};
+
+template <class T>
+class product_node : public expression<product_node<T>> {
+public:
+  using value_type = T;
+
+  template <class L, class R>
+  product_node(const L& left, const R& right) : _left(operand_of(left)), _right(operand_of(right)) {
+    assert(_left.cols == _right.rows);
+  }
+
+  size_t rows() const {
+    return _left.rows;
+  }
+
+  size_t cols() const {
+    return _right.cols;
+  }
+
+  // Before prepare() every value is an inner product of its own
+  T value(size_t row, size_t col) const {
+    if (_result) {
+      return (*_result)(row, col);
+    }
+    T res = T();
+    for (size_t p = 0; p < _left.cols; ++p) {
+      res = res + _left.data[row * _left.stride + p] * _right.data[p * _right.stride + col];
+    }
+    return res;
+  }
+
+  void prepare() const {
+    if (!_result) {
+      std::shared_ptr<matrix<T>> res(new matrix<T>(rows(), cols(), matrix<T>::for_overwrite));
+      res->construct_for_overwrite();
+      multiply_into(res->data(), res->stride(), false);
+      _result = std::move(res);
+    }
+  }
+
+  // The product is written while the operands are read, so any overlap is an alias
+  bool aliases(const T* dst, size_t stride) const {
+    return touches(_left, dst, stride) || touches(_right, dst, stride);
+  }
+
+  // dst = left * right, or dst += left * right if accumulate; dst must not alias the operands
+  void multiply_into(T* dst, size_t stride, bool accumulate) const {
+    matrix<T>::multiply(rows(), cols(), _left.cols, _left.data, _left.stride, _right.data, _right.stride, dst, stride,
+                        accumulate);
+  }
+
+private:
+  // Operands that are expressions themselves are computed into matrices owned by the node
+  struct factor {
+    const T* data;
+    size_t rows;
+    size_t cols;
+    size_t stride;
+    std::shared_ptr<const matrix<T>> owner;
+  };
+
+  factor _left;
+  factor _right;
+  mutable std::shared_ptr<const matrix<T>> _result;
+
+  static factor operand_of(const matrix<T>& m) {
+    return {m.data(), m.rows(), m.cols(), m.stride(), nullptr};
+  }
+
+  template <class U>
+  static factor operand_of(const matrix_view<U>& v) {
+    return {v.data(), v.rows(), v.cols(), v.stride(), nullptr};
+  }
+
+  template <size_t Rows, size_t Cols>
+  static factor operand_of(const static_matrix<T, Rows, Cols>& m) {
+    return {m.data(), Rows, Cols, Cols, nullptr};
+  }
+
+  template <node E>
+  static factor operand_of(const E& e) {
+    auto m = std::make_shared<const matrix<T>>(e);
+    return {m->data(), m->rows(), m->cols(), m->stride(), m};
+  }
+
+  // Whether the extents of an operand and of the destination share an address
+  bool touches(const factor& f, const T* dst, size_t stride) const {
+    if (f.rows == 0 || f.cols == 0 || this->empty()) {
+      return false;
+    }
+    std::less<const T*> less;
+    const T* f_end = f.data + (f.rows - 1) * f.stride + f.cols;
+    const T* dst_end = dst + (rows() - 1) * stride + cols();
+    return less(f.data, dst_end) && less(dst, f_end);
+  }
+};
+
+template <class E>
+struct is_leaf : std::false_type {};
+
+template <class T>
+struct is_leaf<leaf<T>> : std::true_type {};
+
+// alpha * A
+template <class E>
+struct is_scaled_leaf : std::false_type {};
+
+template <class T>
+struct is_scaled_leaf<scale_node<leaf<T>>> : std::true_type {};
+
+template <class E>
+struct is_product : std::false_type {};
+
+template <class T>
+struct is_product<product_node<T>> : std::true_type {};
+
+// A * B + C or C + A * B
+template <class E>
+struct is_sum_with_product : std::false_type {};
+
+template <class T, class L, class R>
+struct is_sum_with_product<binary_node<std::plus<T>, L, R>>
+    : std::bool_constant<is_product<L>::value || is_product<R>::value> {};
+
+enum class assign_op { assign, add, subtract };
+
+template <class T>
+void apply(T& dst, const T& value, assign_op op) {
+  switch (op) {
+  case assign_op::assign:
+    dst = value;
+    break;
+  case assign_op::add:
+    dst = dst + value;
+    break;
+  case assign_op::subtract:
+    dst = dst - value;
+    break;
+  }
+}
+
+// Writes e into dst (e.rows() x e.cols() with row stride stride) with op. If evaluating in place
+// would read overwritten elements, e is computed into a temporary first.
+template <node E, class T>
+void evaluate(const E& e, T* dst, size_t stride, assign_op op) {
+  if (e.empty()) {
+    return;
+  }
+  if (e.aliases(dst, stride)) {
+    matrix<T> tmp = e;
+    evaluate(wrap(tmp), dst, stride, op);
+    return;
+  }
+  // f(row, col, count, out) writes a piece of a row starting at out. When dst and the source are
+  // both without gaps, the elements are handed out as one long row.
+  auto for_each_span = [&](bool flat, auto f) {
+    size_t rows = flat ? 1 : e.rows();
+    size_t cols = flat ? e.size() : e.cols();
+    size_t row_stride = flat ? e.size() : stride;
+    matrix_parallel::for_each_span<T>(rows, cols, row_stride, [&](size_t row, size_t col, size_t count) {
+      f(row, col, count, dst + row * row_stride + col);
+    });
+  };
+  // Copies, sums and axpy of matrices go to the row kernels
+  if constexpr (is_leaf<E>::value) {
+    for_each_span(stride == e.cols() && e.contiguous(), [&](size_t row, size_t col, size_t count, T* out) {
+      const T* src = e.row(row) + col;
+      if (op == assign_op::assign) {
+        if (out != src) {
+          std::copy_n(src, count, out);
+        }
+      } else if (op == assign_op::add) {
+        matrix_simd::transform(out, src, count, matrix_simd::add());
+      } else {
+        matrix_simd::transform(out, src, count, matrix_simd::subtract());
+      }
+    });
+    return;
+  } else if constexpr (is_scaled_leaf<E>::value && matrix_simd::enabled<T>) {
+    if (op != assign_op::assign) {
+      matrix_simd::add_scaled<T> axpy{op == assign_op::add ? e.factor() : -e.factor()};
+      bool flat = stride == e.cols() && e.operand().contiguous();
+      for_each_span(flat, [&](size_t row, size_t col, size_t count, T* out) {
+        matrix_simd::transform(out, e.operand().row(row) + col, count, axpy);
+      });
+      return;
+    }
+  } else if constexpr (is_product<E>::value) {
+    if (op != assign_op::subtract) {
+      e.multiply_into(dst, stride, op == assign_op::add);
+      return;
+    }
+  } else if constexpr (is_sum_with_product<E>::value) {
+    if (op != assign_op::subtract) {
+      if constexpr (is_product<std::decay_t<decltype(e.left())>>::value) {
+        evaluate(e.right(), dst, stride, op);
+        e.left().multiply_into(dst, stride, true);
+      } else {
+        evaluate(e.left(), dst, stride, op);
+        e.right().multiply_into(dst, stride, true);
+      }
+      return;
+    }
+  }
+  e.prepare();
+  for_each_span(false, [&](size_t row, size_t col, size_t count, T* out) {
+    for (size_t i = 0; i < count; ++i) {
+      apply(out[i], e.value(row, col + i), op);
+    }
+  });
+}
+
+template <class Op, class L, class R>
+auto make_binary(const L& left, const R& right) {
+  return binary_node<Op, node_t<L>, node_t<R>>(wrap(left), wrap(right));
+}
+} // namespace matrix_expr
+
+template <class L, class R>
+  requires matrix_expr::operand<L> && matrix_expr::operand<R>
+auto operator+(const L& left, const R& right) {
+  return matrix_expr::make_binary<std::plus<matrix_expr::value_t<L>>>(left, right);
+}
+
+template <class L, class R>
+  requires matrix_expr::operand<L> && matrix_expr::operand<R>
+auto operator-(const L& left, const R& right) {
+  return matrix_expr::make_binary<std::minus<matrix_expr::value_t<L>>>(left, right);
+}
+
+template <class L, class R>
+  requires matrix_expr::operand<L> && matrix_expr::operand<R>
+matrix_expr::product_node<matrix_expr::value_t<L>> operator*(const L& left, const R& right) {
+  return {left, right};
+}
+
+template <class E>
+  requires matrix_expr::operand<E>
+auto operator*(const E& e, const matrix_expr::value_t<E>& factor) {
+  return matrix_expr::scale_node<matrix_expr::node_t<E>>(matrix_expr::wrap(e), factor);
+}
+
+template <class E>
+  requires matrix_expr::operand<E>
+auto operator*(const matrix_expr::value_t<E>& factor, const E& e) {
+  return matrix_expr::scale_node<matrix_expr::node_t<E>>(matrix_expr::wrap(e), factor);
+}
+
+// Comparison with an expression or a view on either side, products are computed first
+template <class L, class R>
+  requires matrix_expr::operand<L> && matrix_expr::operand<R> &&
+           (!std::is_same_v<L, matrix<matrix_expr::value_t<L>>> || !std::is_same_v<R, matrix<matrix_expr::value_t<R>>>)
+bool operator==(const L& left, const R& right) {
+  matrix_expr::node_t<L> l = matrix_expr::wrap(left);
+  matrix_expr::node_t<R> r = matrix_expr::wrap(right);
+  if (l.empty() && r.empty()) {
+    return true;
+  }
+  if (l.rows() != r.rows() || l.cols() != r.cols()) {
+    return false;
+  }
+  l.prepare();
+  r.prepare();
+  for (size_t row = 0; row < l.rows(); ++row) {
+    for (size_t col = 0; col < l.cols(); ++col) {
+      if (!(l.value(row, col) == r.value(row, col))) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+template <class L, class R>
+  requires matrix_expr::operand<L> && matrix_expr::operand<R> &&
+           (!std::is_same_v<L, matrix<matrix_expr::value_t<L>>> || !std::is_same_v<R, matrix<matrix_expr::value_t<R>>>)
+bool operator!=(const L& left, const R& right) {
+  return !(left == right);
+}
@@ -0,0 +1,149 @@
+// Checks that the dispatched kernels match a scalar loop bit for bit at the width picked for this CPU.
+// Build it next to the sources, with and without -march=native and -ffp-contract=fast, and run it, it
+// prints nothing on success:
+//   g++ -std=c++20 -O2 matrix-simd-check.cpp
+
+#include "matrix-simd.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <random>
+#include <type_traits>
+
+namespace {
+// Lengths up to a few 64-byte vectors, so the tails of every width and the four-accumulator
+// reduction loop are covered
+constexpr size_t max_count = 150;
+
+// The product is stored through a volatile, so that the reference is never contracted either
+template <class T>
+T rounded_product(T a, T b) {
+  volatile T res = a * b;
+  return res;
+}
+
+template <class T>
+bool same_bits(const T* a, const T* b, size_t count) {
+  return std::memcmp(a, b, count * sizeof(T)) == 0;
+}
+
+template <class T>
+std::unique_ptr<T[]> copy_of(const T* src, size_t count) {
+  std::unique_ptr<T[]> res(new T[count]);
+  std::memcpy(res.get(), src, count * sizeof(T));
+  return res;
+}
+
+template <class T, class Op, class Ref>
+void check_zip(const T* a, const T* b, size_t count, const Op& op, Ref ref) {
+  std::unique_ptr<T[]> res = copy_of(a, count);
+  std::unique_ptr<T[]> expected(new T[count]);
+  matrix_simd::transform(res.get(), b, count, op);
+  for (size_t i = 0; i < count; ++i) {
+    expected[i] = ref(a[i], b[i]);
+  }
+  assert(same_bits(res.get(), expected.get(), count));
+}
+
+// The reference starts from start(a[0]) and folds the other elements in order with step
+template <class T, class Op, class Start, class Step>
+void check_reduce(const T* a, size_t count, const Op& op, Start start, Step step) {
+  T expected = start(a[0]);
+  for (size_t i = 1; i < count; ++i) {
+    expected = step(expected, a[i]);
+  }
+  T res = matrix_simd::reduce(a, count, op);
+  assert(same_bits(&res, &expected, 1));
+}
+
+template <class T>
+void check_equal(const T* a, size_t count) {
+  std::unique_ptr<T[]> b = copy_of(a, count);
+  assert(matrix_simd::equal(a, b.get(), count));
+  for (size_t k = 0; k < count; ++k) {
+    b[k] = b[k] + T(1);
+    assert(!matrix_simd::equal(a, b.get(), count));
+    b[k] = a[k];
+  }
+  if constexpr (std::is_floating_point_v<T>) {
+    // equal() compares values like ==, not bits
+    std::unique_ptr<T[]> zeros(new T[count]());
+    std::unique_ptr<T[]> negative_zeros(new T[count]);
+    std::unique_ptr<T[]> nans(new T[count]);
+    for (size_t i = 0; i < count; ++i) {
+      negative_zeros[i] = -T(0);
+      nans[i] = std::numeric_limits<T>::quiet_NaN();
+    }
+    assert(matrix_simd::equal(zeros.get(), negative_zeros.get(), count));
+    assert(!matrix_simd::equal(nans.get(), nans.get(), count));
+  }
+}
+
+template <class T>
+void check(std::mt19937_64& rng) {
+  // small integers, so that every sum and product is exact for the reductions and the integer types
+  // never overflow
+  std::uniform_int_distribution<int> values(-50, 50);
+  std::uniform_int_distribution<int> divisors(1, 9);
+  std::uniform_real_distribution<double> reals(-10, 10);
+  T factor = std::is_floating_point_v<T> ? T(0.1) : T(3);
+  for (size_t n = 1; n < max_count; ++n) {
+    std::unique_ptr<T[]> a(new T[n]);
+    std::unique_ptr<T[]> b(new T[n]);
+    std::unique_ptr<T[]> small(new T[n]);
+    for (size_t i = 0; i < n; ++i) {
+      a[i] = std::is_floating_point_v<T> ? static_cast<T>(reals(rng)) : static_cast<T>(values(rng));
+      b[i] = static_cast<T>(divisors(rng) * (rng() % 2 == 0 ? 1 : -1));
+      small[i] = static_cast<T>(values(rng));
+    }
+
+    check_zip(a.get(), b.get(), n, matrix_simd::add_scaled<T>{factor},
+              [&](T x, T y) { return x + rounded_product(y, factor); });
+    check_zip(a.get(), b.get(), n, matrix_simd::multiply(), [](T x, T y) { return rounded_product(x, y); });
+    check_zip(a.get(), b.get(), n, matrix_simd::add(), [](T x, T y) { return x + y; });
+    check_zip(a.get(), b.get(), n, matrix_simd::subtract(), [](T x, T y) { return x - y; });
+    check_zip(a.get(), b.get(), n, matrix_simd::divide(), [](T x, T y) { return x / y; });
+
+    std::unique_ptr<T[]> res = copy_of(a.get(), n);
+    matrix_simd::transform(res.get(), n, matrix_simd::scale<T>{factor});
+    for (size_t i = 0; i < n; ++i) {
+      T expected = rounded_product(a[i], factor);
+      assert(same_bits(&res[i], &expected, 1));
+    }
+
+    auto same = [](T x) { return x; };
+    check_reduce(small.get(), n, matrix_simd::sum(), same, [](T acc, T x) { return acc + x; });
+    check_reduce(small.get(), n, matrix_simd::sum_of_squares(), [](T x) { return x * x; },
+                 [](T acc, T x) { return acc + x * x; });
+    check_reduce(a.get(), n, matrix_simd::min(), same, [](T acc, T x) { return std::min(acc, x); });
+    check_reduce(a.get(), n, matrix_simd::max(), same, [](T acc, T x) { return std::max(acc, x); });
+    check_equal(a.get(), n);
+  }
+}
+} // namespace
+
+int main() {
+  std::mt19937_64 rng(23);
+  check<double>(rng);
+  check<float>(rng);
+  check<int64_t>(rng);
+  check<int32_t>(rng);
+
+  // A fused multiply-add keeps the unrounded product and leaves -2.78e-17 here
+  constexpr size_t count = 16;
+  std::unique_ptr<double[]> d(new double[count]);
+  std::unique_ptr<double[]> b(new double[count]);
+  for (size_t i = 0; i < count; ++i) {
+    d[i] = -rounded_product(0.1, 3.0);
+    b[i] = 0.1;
+  }
+  matrix_simd::transform(d.get(), b.get(), count, matrix_simd::add_scaled<double>{3.0});
+  for (size_t i = 0; i < count; ++i) {
+    assert(d[i] == 0);
+  }
+}
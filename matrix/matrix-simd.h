@@ -0,0 +1,389 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+// Elementwise kernels over contiguous ranges, used for whole rows of a matrix. For float, double,
+// int32_t and int64_t they are written with GCC/Clang vector types and compiled for several widths;
+// the widest one the CPU supports is picked at run time. Other types and compilers take a plain
+// loop. Elementwise results are the same at every width, reductions may differ in the last bits
+// between CPUs because the partial sums are grouped by the vector width.
+namespace matrix_simd {
+#if defined(__GNUC__)
+#define MATRIX_SIMD_VECTORS 1
+#else
+#define MATRIX_SIMD_VECTORS 0
+#endif
+
+#if MATRIX_SIMD_VECTORS && (defined(__x86_64__) || defined(__i386__))
+#define MATRIX_SIMD_DISPATCH 1
+#else
+#define MATRIX_SIMD_DISPATCH 0
+#endif
+
+// Kernels are inlined into the wrappers compiled for each target, which is what widens them
+#if defined(__GNUC__)
+#define MATRIX_SIMD_INLINE __attribute__((always_inline))
+#else
+#define MATRIX_SIMD_INLINE
+#endif
+
+template <class T>
+inline constexpr bool enabled = MATRIX_SIMD_VECTORS && (std::is_same_v<T, float> || std::is_same_v<T, double> ||
+                                                        std::is_same_v<T, int32_t> || std::is_same_v<T, int64_t>);
+
+enum class level {
+  generic,
+  avx2,
+  avx512,
+};
+
+inline level detect() {
+#if MATRIX_SIMD_DISPATCH
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    return level::avx512;
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    return level::avx2;
+  }
+#endif
+  return level::generic;
+}
+
+// Detected once per process
+inline level current() {
+  static const level res = detect();
+  return res;
+}
+
+#if MATRIX_SIMD_VECTORS
+template <class T, size_t Bytes>
+struct vector_of {
+  typedef T type __attribute__((vector_size(Bytes)));
+};
+#endif
+
+// Everything below is compiled without floating-point contraction: a target("avx512f") wrapper would
+// otherwise turn a + b * c into a fused multiply-add that the generic and AVX2 paths cannot form, and
+// the elementwise results would depend on the CPU
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+// Operations work in place on a vector or on a single element alike, they take references so that
+// wide vectors never cross a call boundary
+
+struct add {
+  template <class V>
+  [[gnu::always_inline]] void operator()(V& a, const V& b) const {
+    a = a + b;
+  }
+};
+
+struct subtract {
+  template <class V>
+  [[gnu::always_inline]] void operator()(V& a, const V& b) const {
+    a = a - b;
+  }
+};
+
+struct multiply {
+  template <class V>
+  [[gnu::always_inline]] void operator()(V& a, const V& b) const {
+    a = a * b;
+  }
+};
+
+struct divide {
+  template <class V>
+  [[gnu::always_inline]] void operator()(V& a, const V& b) const {
+    a = a / b;
+  }
+};
+
+template <class T>
+struct scale {
+  T factor;
+
+  template <class V>
+  [[gnu::always_inline]] void operator()(V& a) const {
+    a = a * factor;
+  }
+};
+
+template <class T>
+struct add_scaled {
+  T factor;
+
+  // two statements, which Clang does not contract either
+  template <class V>
+  [[gnu::always_inline]] void operator()(V& a, const V& b) const {
+    V product = b * factor;
+    a = a + product;
+  }
+};
+
+// Reductions start an accumulator from an element with start(), fold elements into it with step()
+// and accumulators together with merge()
+
+struct sum {
+  template <class V>
+  [[gnu::always_inline]] void start(V&) const {}
+
+  template <class V>
+  [[gnu::always_inline]] void step(V& acc, const V& a) const {
+    acc = acc + a;
+  }
+
+  template <class V>
+  [[gnu::always_inline]] void merge(V& acc, const V& a) const {
+    acc = acc + a;
+  }
+};
+
+struct sum_of_squares {
+  template <class V>
+  [[gnu::always_inline]] void start(V& acc) const {
+    acc = acc * acc;
+  }
+
+  template <class V>
+  [[gnu::always_inline]] void step(V& acc, const V& a) const {
+    V square = a * a;
+    acc = acc + square;
+  }
+
+  template <class V>
+  [[gnu::always_inline]] void merge(V& acc, const V& a) const {
+    acc = acc + a;
+  }
+};
+
+struct min {
+  template <class V>
+  [[gnu::always_inline]] void start(V&) const {}
+
+  template <class V>
+  [[gnu::always_inline]] void step(V& acc, const V& a) const {
+    acc = a < acc ? a : acc;
+  }
+
+  template <class V>
+  [[gnu::always_inline]] void merge(V& acc, const V& a) const {
+    step(acc, a);
+  }
+};
+
+struct max {
+  template <class V>
+  [[gnu::always_inline]] void start(V&) const {}
+
+  template <class V>
+  [[gnu::always_inline]] void step(V& acc, const V& a) const {
+    acc = acc < a ? a : acc;
+  }
+
+  template <class V>
+  [[gnu::always_inline]] void merge(V& acc, const V& a) const {
+    step(acc, a);
+  }
+};
+
+namespace kernels {
+#if MATRIX_SIMD_VECTORS
+template <class V, class T>
+[[gnu::always_inline]] inline void load(V& dst, const T* src) {
+  __builtin_memcpy(&dst, src, sizeof(V));
+}
+
+template <class V, class T>
+[[gnu::always_inline]] inline void store(T* dst, const V& value) {
+  __builtin_memcpy(dst, &value, sizeof(V));
+}
+#endif
+
+// op(dst[i])
+template <size_t Bytes, class T, class Op>
+[[gnu::always_inline]] inline void map(T* dst, size_t count, const Op& op) {
+  size_t i = 0;
+#if MATRIX_SIMD_VECTORS
+  if constexpr (enabled<T>) {
+    using V = typename vector_of<T, Bytes>::type;
+    constexpr size_t lanes = Bytes / sizeof(T);
+    for (; i + lanes <= count; i += lanes) {
+      V a;
+      load(a, dst + i);
+      op(a);
+      store(dst + i, a);
+    }
+  }
+#endif
+  for (; i < count; ++i) {
+    op(dst[i]);
+  }
+}
+
+// op(dst[i], src[i])
+template <size_t Bytes, class T, class Op>
+[[gnu::always_inline]] inline void zip(T* dst, const T* src, size_t count, const Op& op) {
+  size_t i = 0;
+#if MATRIX_SIMD_VECTORS
+  if constexpr (enabled<T>) {
+    using V = typename vector_of<T, Bytes>::type;
+    constexpr size_t lanes = Bytes / sizeof(T);
+    for (; i + lanes <= count; i += lanes) {
+      V a, b;
+      load(a, dst + i);
+      load(b, src + i);
+      op(a, b);
+      store(dst + i, a);
+    }
+  }
+#endif
+  for (; i < count; ++i) {
+    op(dst[i], src[i]);
+  }
+}
+
+// Folds src[0..count) in four interleaved vector accumulators to hide the latency of the operation
+template <size_t Bytes, class T, class Op>
+[[gnu::always_inline]] inline T reduce(const T* src, size_t count, const Op& op) {
+  assert(count > 0);
+  T res = src[0];
+  op.start(res);
+  size_t i = 1;
+#if MATRIX_SIMD_VECTORS
+  if constexpr (enabled<T>) {
+    using V = typename vector_of<T, Bytes>::type;
+    constexpr size_t lanes = Bytes / sizeof(T);
+    if (count >= 1 + 4 * lanes) {
+      V acc[4];
+      V a;
+      for (size_t j = 0; j < 4; ++j) {
+        load(acc[j], src + 1 + j * lanes);
+        op.start(acc[j]);
+      }
+      for (i = 1 + 4 * lanes; i + 4 * lanes <= count; i += 4 * lanes) {
+        for (size_t j = 0; j < 4; ++j) {
+          load(a, src + i + j * lanes);
+          op.step(acc[j], a);
+        }
+      }
+      op.merge(acc[0], acc[1]);
+      op.merge(acc[2], acc[3]);
+      op.merge(acc[0], acc[2]);
+      for (; i + lanes <= count; i += lanes) {
+        load(a, src + i);
+        op.step(acc[0], a);
+      }
+      for (size_t j = 0; j < lanes; ++j) {
+        T lane = acc[0][j];
+        op.merge(res, lane);
+      }
+      for (; i < count; ++i) {
+        op.step(res, src[i]);
+      }
+      return res;
+    }
+  }
+#endif
+  for (; i < count; ++i) {
+    op.step(res, src[i]);
+  }
+  return res;
+}
+
+// Whether a[i] == b[i] for every i
+template <size_t Bytes, class T>
+[[gnu::always_inline]] inline bool equal(const T* a, const T* b, size_t count) {
+  size_t i = 0;
+#if MATRIX_SIMD_VECTORS
+  if constexpr (enabled<T>) {
+    using V = typename vector_of<T, Bytes>::type;
+    constexpr size_t lanes = Bytes / sizeof(T);
+    // a lane of a comparison is all ones where it holds
+    decltype(V() != V()) differ = {};
+    V x, y;
+    for (; i + lanes <= count; i += lanes) {
+      load(x, a + i);
+      load(y, b + i);
+      differ = differ | (x != y);
+    }
+    for (size_t j = 0; j < lanes; ++j) {
+      if (differ[j]) {
+        return false;
+      }
+    }
+  }
+#endif
+  for (; i < count; ++i) {
+    if (!(a[i] == b[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+#if MATRIX_SIMD_DISPATCH
+template <class K>
+__attribute__((target("avx2"))) auto run_avx2(const K& kernel) {
+  return kernel.template operator()<32>();
+}
+
+template <class K>
+__attribute__((target("avx512f"))) auto run_avx512(const K& kernel) {
+  return kernel.template operator()<64>();
+}
+#endif
+
+// Runs kernel.operator()<Bytes>() compiled for the widest vectors the CPU has
+template <class T, class K>
+auto dispatch(const K& kernel) {
+#if MATRIX_SIMD_DISPATCH
+  if constexpr (enabled<T>) {
+    switch (current()) {
+    case level::avx512:
+      return run_avx512(kernel);
+    case level::avx2:
+      return run_avx2(kernel);
+    default:
+      break;
+    }
+  }
+#endif
+  return kernel.template operator()<16>();
+}
+} // namespace kernels
+
+template <class T, class Op>
+void transform(T* dst, size_t count, const Op& op) {
+  kernels::dispatch<T>([&]<size_t Bytes>() MATRIX_SIMD_INLINE { kernels::map<Bytes>(dst, count, op); });
+}
+
+template <class T, class Op>
+void transform(T* dst, const T* src, size_t count, const Op& op) {
+  kernels::dispatch<T>(
+      [&]<size_t Bytes>() MATRIX_SIMD_INLINE { kernels::zip<Bytes>(dst, src, count, op); });
+}
+
+// count must be positive
+template <class T, class Op>
+T reduce(const T* src, size_t count, const Op& op) {
+  return kernels::dispatch<T>(
+      [&]<size_t Bytes>() MATRIX_SIMD_INLINE { return kernels::reduce<Bytes>(src, count, op); });
+}
+
+template <class T>
+bool equal(const T* a, const T* b, size_t count) {
+  return kernels::dispatch<T>(
+      [&]<size_t Bytes>() MATRIX_SIMD_INLINE { return kernels::equal<Bytes>(a, b, count); });
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC pop_options
+#endif
+} // namespace matrix_simd
@@ -0,0 +1,243 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+#include "matrix-expr.h"
+
+// Non-owning rows x cols window into row-major storage whose rows start stride elements apart, as
+// returned by matrix::submatrix(). matrix_view<const T> is read-only. Views are accepted wherever a
+// matrix is by the arithmetic operators and the product, and assigning through one writes the
+// elements it covers. A view must not outlive the storage it refers to.
+template <class T>
+class matrix_view {
+public:
+  using value_type = std::remove_const_t<T>;
+
+  using reference = T&;
+  using pointer = T*;
+
+  using row_iterator = pointer;
+
+  matrix_view() : _data(nullptr), _rows(0), _cols(0), _stride(0) {}
+
+  matrix_view(pointer data, size_t rows, size_t cols, size_t stride)
+      : _data(rows * cols == 0 ? nullptr : data),
+        _rows(rows * cols == 0 ? 0 : rows),
+        _cols(rows * cols == 0 ? 0 : cols),
+        _stride(stride) {
+    assert(rows <= 1 || cols <= stride);
+  }
+
+  matrix_view(pointer data, size_t rows, size_t cols) : matrix_view(data, rows, cols, cols) {}
+
+  operator matrix_view<const T>() const {
+    return {_data, _rows, _cols, _stride};
+  }
+
+  // Iterators
+
+  row_iterator row_begin(size_t row) const {
+    assert(row < _rows);
+    return _data + row * _stride;
+  }
+
+  row_iterator row_end(size_t row) const {
+    return row_begin(row) + _cols;
+  }
+
+  // Size
+
+  size_t rows() const {
+    return _rows;
+  }
+
+  size_t cols() const {
+    return _cols;
+  }
+
+  size_t size() const {
+    return _rows * _cols;
+  }
+
+  bool empty() const {
+    return size() == 0;
+  }
+
+  // Distance between the starts of consecutive rows, in elements
+  size_t stride() const {
+    return _stride;
+  }
+
+  // Whether the elements are stored without gaps between rows
+  bool contiguous() const {
+    return _rows <= 1 || _stride == _cols;
+  }
+
+  // Elements access
+
+  reference operator()(size_t row, size_t col) const {
+    assert(row < _rows && col < _cols);
+    return _data[row * _stride + col];
+  }
+
+  pointer data() const {
+    return _data;
+  }
+
+  matrix_view submatrix(size_t row, size_t col, size_t rows, size_t cols) const {
+    assert(row + rows <= _rows && col + cols <= _cols);
+    return {_data + row * _stride + col, rows, cols, _stride};
+  }
+
+  // Writes through the view, operands may overlap it
+
+  template <matrix_expr::operand E>
+  const matrix_view& assign(const E& e) const
+    requires (!std::is_const_v<T>)
+  {
+    assert(_rows == e.rows() && _cols == e.cols());
+    matrix_expr::evaluate(matrix_expr::wrap(e), _data, _stride, matrix_expr::assign_op::assign);
+    return *this;
+  }
+
+  template <matrix_expr::operand E>
+  const matrix_view& operator+=(const E& e) const
+    requires (!std::is_const_v<T>)
+  {
+    assert(_rows == e.rows() && _cols == e.cols());
+    matrix_expr::evaluate(matrix_expr::wrap(e), _data, _stride, matrix_expr::assign_op::add);
+    return *this;
+  }
+
+  template <matrix_expr::operand E>
+  const matrix_view& operator-=(const E& e) const
+    requires (!std::is_const_v<T>)
+  {
+    assert(_rows == e.rows() && _cols == e.cols());
+    matrix_expr::evaluate(matrix_expr::wrap(e), _data, _stride, matrix_expr::assign_op::subtract);
+    return *this;
+  }
+
+  const matrix_view& operator*=(const value_type& factor) const
+    requires (!std::is_const_v<T>)
+  {
+    for (size_t row = 0; row < _rows; ++row) {
+      for (pointer it = row_begin(row); it != row_end(row); ++it) {
+        *it = *it * factor;
+      }
+    }
+    return *this;
+  }
+
+  const matrix_view& fill(const value_type& value) const
+    requires (!std::is_const_v<T>)
+  {
+    for (size_t row = 0; row < _rows; ++row) {
+      std::fill(row_begin(row), row_end(row), value);
+    }
+    return *this;
+  }
+
+private:
+  pointer _data;
+  size_t _rows;
+  size_t _cols;
+  size_t _stride;
+};
+
+template <class T>
+using const_matrix_view = matrix_view<const T>;
+
+// Cache-oblivious transpose: the larger side is halved until a block fits in a few cache lines, so
+// both the reads and the writes stay in cache at every level without tuning for its size
+namespace matrix_transpose {
+// Side of the blocks copied directly
+inline constexpr size_t leaf_size = 16;
+
+// dst (cols x rows) = src (rows x cols) transposed
+template <class T>
+void copy(const T* src, size_t src_stride, T* dst, size_t dst_stride, size_t rows, size_t cols) {
+  while (rows > leaf_size || cols > leaf_size) {
+    if (rows >= cols) {
+      size_t half = rows / 2;
+      copy(src, src_stride, dst, dst_stride, half, cols);
+      src += half * src_stride;
+      dst += half;
+      rows -= half;
+    } else {
+      size_t half = cols / 2;
+      copy(src, src_stride, dst, dst_stride, rows, half);
+      src += half;
+      dst += half * dst_stride;
+      cols -= half;
+    }
+  }
+  for (size_t row = 0; row < rows; ++row) {
+    for (size_t col = 0; col < cols; ++col) {
+      dst[col * dst_stride + row] = src[row * src_stride + col];
+    }
+  }
+}
+
+// Swaps a (rows x cols) with b (cols x rows) transposed
+template <class T>
+void swap(T* a, T* b, size_t stride, size_t rows, size_t cols) {
+  while (rows > leaf_size || cols > leaf_size) {
+    if (rows >= cols) {
+      size_t half = rows / 2;
+      swap(a, b, stride, half, cols);
+      a += half * stride;
+      b += half;
+      rows -= half;
+    } else {
+      size_t half = cols / 2;
+      swap(a, b, stride, rows, half);
+      a += half;
+      b += half * stride;
+      cols -= half;
+    }
+  }
+  using std::swap;
+  for (size_t row = 0; row < rows; ++row) {
+    for (size_t col = 0; col < cols; ++col) {
+      swap(a[row * stride + col], b[col * stride + row]);
+    }
+  }
+}
+
+// Transposes the n x n block at a in place
+template <class T>
+void square(T* a, size_t stride, size_t n) {
+  if (n <= leaf_size) {
+    using std::swap;
+    for (size_t row = 1; row < n; ++row) {
+      for (size_t col = 0; col < row; ++col) {
+        swap(a[row * stride + col], a[col * stride + row]);
+      }
+    }
+    return;
+  }
+  size_t half = n / 2;
+  square(a, stride, half);
+  square(a + half * stride + half, stride, n - half);
+  swap(a + half, a + half * stride, stride, half, n - half);
+}
+} // namespace matrix_transpose
+
+// dst = src transposed, dst must be src.cols() x src.rows() and must not overlap src
+template <class T>
+void transpose(const_matrix_view<std::type_identity_t<T>> src, matrix_view<T> dst) {
+  assert(src.rows() == dst.cols() && src.cols() == dst.rows());
+  matrix_transpose::copy(src.data(), src.stride(), dst.data(), dst.stride(), src.rows(), src.cols());
+}
+
+// Transposes a square view in place
+template <class T>
+void transpose(matrix_view<T> v) {
+  assert(v.rows() == v.cols());
+  matrix_transpose::square(v.data(), v.stride(), v.rows());
+}
@@ -2,15 +2,338 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <new>
 #include <numeric>
+#include <type_traits>
+#include <utility>
+
+#include "matrix-expr.h"
+#include "matrix-simd.h"
+#include "matrix-view.h"
+#include "thread-pool.h"
+
+namespace matrix_gemm {
+// Blocked matrix product C = A * B (or C += A * B), all row-major with leading dimensions lda, ldb, ldc.
+// Blocks of B (kc x nc) and A (mc x kc) are packed into contiguous panels of nr columns and mr rows,
+// then a micro-kernel keeps an mr x nr tile of C in registers while it walks the shared dimension.
+
+#if defined(__GNUC__)
+#define MATRIX_GEMM_VECTORS 1
+#else
+#define MATRIX_GEMM_VECTORS 0
+#endif
+
+// Width of the registers the micro-kernel is compiled for. It only shapes the register tile, storage
+// layout never depends on it.
+#if defined(__AVX512F__)
+inline constexpr size_t vector_bytes = 64;
+#elif defined(__AVX__)
+inline constexpr size_t vector_bytes = 32;
+#else
+inline constexpr size_t vector_bytes = 16;
+#endif
+
+#if MATRIX_GEMM_VECTORS
+// GCC/Clang vector extension type, lowered to the widest registers the target has
+template <class T>
+struct vector_of {
+  typedef T type __attribute__((vector_size(vector_bytes)));
+};
+#endif
+
+template <class T>
+struct params {
+  static constexpr bool vectorized = MATRIX_GEMM_VECTORS && sizeof(T) <= 8;
+  static constexpr size_t lanes = vectorized ? vector_bytes / sizeof(T) : 4;
+  // a register tile is 6 rows by two vectors: 12 accumulators fit 16 registers with room for the operands
+  static constexpr size_t mr = 6;
+  static constexpr size_t nr = 2 * lanes;
+  // packed A fits in L2, a panel of packed B in L1
+  static constexpr size_t kc = 256;
+  static constexpr size_t mc = 20 * mr;
+  static constexpr size_t nc = 4096;
+};
+
+template <class T>
+inline constexpr bool enabled = std::is_arithmetic_v<T> && !std::is_same_v<T, bool>;
+
+// Below this many multiply-adds packing does not pay off
+inline constexpr size_t small_product = 32 * 32 * 32;
+
+// Copies rows [0, m) x cols [0, k) of A into panels of mr rows stored column by column, the last
+// panel is padded with zeros
+template <class T>
+void pack_a(size_t m, size_t k, const T* a, size_t lda, T* dst) {
+  constexpr size_t mr = params<T>::mr;
+  for (size_t i = 0; i < m; i += mr) {
+    size_t rows = std::min(mr, m - i);
+    for (size_t p = 0; p < k; ++p) {
+      for (size_t r = 0; r < mr; ++r) {
+        *dst++ = r < rows ? a[(i + r) * lda + p] : T();
+      }
+    }
+  }
+}
+
+// Copies rows [0, k) x cols [0, n) of B into panels of nr columns stored row by row
+template <class T>
+void pack_b(size_t k, size_t n, const T* b, size_t ldb, T* dst) {
+  constexpr size_t nr = params<T>::nr;
+  for (size_t j = 0; j < n; j += nr) {
+    size_t cols = std::min(nr, n - j);
+    for (size_t p = 0; p < k; ++p) {
+      const T* row = b + p * ldb + j;
+      std::copy_n(row, cols, dst);
+      std::fill(dst + cols, dst + nr, T());
+      dst += nr;
+    }
+  }
+}
+
+// Multiplies a packed mr x k panel by a packed k x nr panel into the top-left rows x cols of C
+template <class T>
+void micro_kernel(size_t k, const T* a, const T* b, T* c, size_t ldc, size_t rows, size_t cols, bool accumulate) {
+  constexpr size_t mr = params<T>::mr;
+  constexpr size_t nr = params<T>::nr;
+  T acc[mr][nr] = {};
+#if MATRIX_GEMM_VECTORS
+  if constexpr (params<T>::vectorized) {
+    using vector = typename vector_of<T>::type;
+    constexpr size_t lanes = params<T>::lanes;
+    vector v[mr][2] = {};
+    for (size_t p = 0; p < k; ++p) {
+      vector b0;
+      vector b1;
+      std::memcpy(&b0, b + p * nr, sizeof(vector));
+      std::memcpy(&b1, b + p * nr + lanes, sizeof(vector));
+      // unrolled so the accumulators stay in registers
+#pragma GCC unroll 8
+      for (size_t i = 0; i < mr; ++i) {
+        T ai = a[p * mr + i];
+        v[i][0] += ai * b0;
+        v[i][1] += ai * b1;
+      }
+    }
+    std::memcpy(acc, v, sizeof(acc));
+  } else
+#endif
+  {
+    for (size_t p = 0; p < k; ++p) {
+      for (size_t i = 0; i < mr; ++i) {
+        T ai = a[p * mr + i];
+        for (size_t j = 0; j < nr; ++j) {
+          acc[i][j] += ai * b[p * nr + j];
+        }
+      }
+    }
+  }
+  for (size_t i = 0; i < rows; ++i) {
+    T* row = c + i * ldc;
+    for (size_t j = 0; j < cols; ++j) {
+      row[j] = accumulate ? row[j] + acc[i][j] : acc[i][j];
+    }
+  }
+}
+
+// Plain i-k-j loop for products too small to pack
+template <class T>
+void gemm_small(size_t m, size_t n, size_t k, const T* a, size_t lda, const T* b, size_t ldb, T* c, size_t ldc,
+                bool accumulate) {
+  for (size_t i = 0; i < m; ++i) {
+    T* row = c + i * ldc;
+    if (!accumulate) {
+      std::fill_n(row, n, T());
+    }
+    for (size_t p = 0; p < k; ++p) {
+      T aip = a[i * lda + p];
+      const T* b_row = b + p * ldb;
+      for (size_t j = 0; j < n; ++j) {
+        row[j] += aip * b_row[j];
+      }
+    }
+  }
+}
+
+template <class T>
+void gemm_blocked(size_t m, size_t n, size_t k, const T* a, size_t lda, const T* b, size_t ldb, T* c, size_t ldc,
+                  bool accumulate) {
+  using p = params<T>;
+  // packing pads the last panels to whole mr rows and nr columns
+  size_t nc_max = (std::min(p::nc, n) + p::nr - 1) / p::nr * p::nr;
+  size_t mc_max = (std::min(p::mc, m) + p::mr - 1) / p::mr * p::mr;
+  std::unique_ptr<T[]> packed_a(new T[mc_max * p::kc]);
+  std::unique_ptr<T[]> packed_b(new T[p::kc * nc_max]);
+  for (size_t jc = 0; jc < n; jc += p::nc) {
+    size_t nc = std::min(p::nc, n - jc);
+    for (size_t pc = 0; pc < k; pc += p::kc) {
+      size_t kc = std::min(p::kc, k - pc);
+      bool acc = accumulate || pc > 0;
+      pack_b(kc, nc, b + pc * ldb + jc, ldb, packed_b.get());
+      for (size_t ic = 0; ic < m; ic += p::mc) {
+        size_t mc = std::min(p::mc, m - ic);
+        pack_a(mc, kc, a + ic * lda + pc, lda, packed_a.get());
+        for (size_t jr = 0; jr < nc; jr += p::nr) {
+          for (size_t ir = 0; ir < mc; ir += p::mr) {
+            micro_kernel(kc, packed_a.get() + ir * kc, packed_b.get() + jr * kc, c + (ic + ir) * ldc + jc + jr, ldc,
+                         std::min(p::mr, mc - ir), std::min(p::nr, nc - jr), acc);
+          }
+        }
+      }
+    }
+  }
+}
+
+// C = A * B, or C += A * B if accumulate; A is m x k, B is k x n. Large products are split by rows
+// over the matrix_parallel pool. The kernel is chosen for the whole product, so every element is
+// summed in the same order whatever the number of threads.
+template <class T>
+void gemm(size_t m, size_t n, size_t k, const T* a, size_t lda, const T* b, size_t ldb, T* c, size_t ldc,
+          bool accumulate) {
+  if (m == 0 || n == 0) {
+    return;
+  }
+  bool small = k == 0 || m * n * k <= small_product;
+  matrix_parallel::for_each_block(m, m * n * k, params<T>::mr, [&](size_t first, size_t last) {
+    if (small) {
+      gemm_small(last - first, n, k, a + first * lda, lda, b, ldb, c + first * ldc, ldc, accumulate);
+    } else {
+      gemm_blocked(last - first, n, k, a + first * lda, lda, b, ldb, c + first * ldc, ldc, accumulate);
+    }
+  });
+}
+} // namespace matrix_gemm
+
+// Walks a column of row-major storage whose rows start stride elements apart
+template <class S>
+struct matrix_col_iterator {
+public:
+  using value_type = std::remove_const_t<S>;
+  using difference_type = std::ptrdiff_t;
+  using reference = S&;
+  using pointer = S*;
+  using iterator_category = std::random_access_iterator_tag;
+
+  matrix_col_iterator() = default;
+
+  matrix_col_iterator(pointer current, size_t stride, size_t col) : _current(current), _cols(stride), _col(col) {}
+
+  operator matrix_col_iterator<const S>() const {
+    return {_current, _cols, _col};
+  }
+
+  reference operator*() const {
+    return _current[_col];
+  }
+
+  pointer operator->() const {
+    return _current + _col;
+  }
+
+  matrix_col_iterator& operator++() {
+    _current += _cols;
+    return *this;
+  }
+
+  matrix_col_iterator operator++(int) {
+    matrix_col_iterator res = *this;
+    ++*this;
+    return res;
+  }
+
+  matrix_col_iterator& operator--() {
+    _current -= _cols;
+    return *this;
+  }
+
+  matrix_col_iterator operator--(int) {
+    matrix_col_iterator res = *this;
+    --*this;
+    return res;
+  }
+
+  matrix_col_iterator& operator+=(const difference_type& other) {
+    _current += other * static_cast<difference_type>(_cols);
+    return *this;
+  }
+
+  matrix_col_iterator& operator-=(const difference_type& other) {
+    _current -= other * static_cast<difference_type>(_cols);
+    return *this;
+  }
+
+  friend matrix_col_iterator operator+(const matrix_col_iterator& left, const difference_type& right) {
+    matrix_col_iterator res = left;
+    res += right;
+    return res;
+  }
+
+  friend matrix_col_iterator operator+(const difference_type& left, const matrix_col_iterator& right) {
+    return right + left;
+  }
+
+  friend matrix_col_iterator operator-(const matrix_col_iterator& left, const difference_type& right) {
+    matrix_col_iterator res = left;
+    res -= right;
+    return res;
+  }
+
+  friend difference_type operator-(const matrix_col_iterator& left, const matrix_col_iterator& right) {
+    return (left._current - right._current) / static_cast<difference_type>(left._cols);
+  }
+
+  reference operator[](difference_type other) const {
+    return *(*this + other);
+  }
+
+  friend bool operator==(const matrix_col_iterator& lhs, const matrix_col_iterator& rhs) {
+    return lhs._current == rhs._current;
+  }
+
+  friend bool operator!=(const matrix_col_iterator& lhs, const matrix_col_iterator& rhs) {
+    return !(lhs == rhs);
+  }
+
+  friend bool operator<(const matrix_col_iterator& lhs, const matrix_col_iterator& rhs) {
+    return lhs._current < rhs._current;
+  }
+
+  friend bool operator<=(const matrix_col_iterator& lhs, const matrix_col_iterator& rhs) {
+    return lhs < rhs || lhs == rhs;
+  }
+
+  friend bool operator>(const matrix_col_iterator& lhs, const matrix_col_iterator& rhs) {
+    return !(lhs <= rhs);
+  }
+
+  friend bool operator>=(const matrix_col_iterator& lhs, const matrix_col_iterator& rhs) {
+    return !(lhs < rhs);
+  }
+
+private:
+  pointer _current;
+  size_t _cols;
+  size_t _col;
+};
+
+enum class matrix_layout {
+  // rows follow each other without gaps
+  packed,
+  // every row starts on a 64-byte boundary, the gap is filled with value-initialized elements
+  padded,
+};
 
 template <class T>
 class matrix {
 private:
+  // Walks the elements row by row, stepping over the padding at the end of each row
   template <class S>
-  struct base_col_iterator {
+  struct base_iterator {
   public:
     using value_type = T;
     using difference_type = std::ptrdiff_t;
@@ -18,110 +341,136 @@ private:
     using pointer = S*;
     using iterator_category = std::random_access_iterator_tag;
 
-    base_col_iterator() = default;
+    base_iterator() = default;
 
-    operator base_col_iterator<const S>() const {
-      return {_current, _cols, _col};
+    operator base_iterator<const S>() const {
+      return {_row, _col, _cols, _stride};
     }
 
     reference operator*() const {
-      return _current[_col];
+      return _row[_col];
     }
 
     pointer operator->() const {
-      return _current + _col;
+      return _row + _col;
     }
 
-    base_col_iterator& operator++() {
-      _current += _cols;
+    base_iterator& operator++() {
+      if (++_col == _cols) {
+        _col = 0;
+        _row += _stride;
+      }
       return *this;
     }
 
-    base_col_iterator operator++(int) {
-      base_col_iterator res = *this;
+    base_iterator operator++(int) {
+      base_iterator res = *this;
       ++*this;
       return res;
     }
 
-    base_col_iterator& operator--() {
-      _current -= _cols;
+    base_iterator& operator--() {
+      if (_col == 0) {
+        _col = _cols;
+        _row -= _stride;
+      }
+      --_col;
       return *this;
     }
 
-    base_col_iterator operator--(int) {
-      base_col_iterator res = *this;
+    base_iterator operator--(int) {
+      base_iterator res = *this;
       --*this;
       return res;
     }
 
-    base_col_iterator& operator+=(const difference_type& other) {
-      _current += other * static_cast<difference_type>(_cols);
+    base_iterator& operator+=(const difference_type& other) {
+      if (other == 0) {
+        return *this;
+      }
+      difference_type cols = static_cast<difference_type>(_cols);
+      difference_type pos = static_cast<difference_type>(_col) + other;
+      difference_type rows = pos / cols;
+      pos %= cols;
+      if (pos < 0) {
+        pos += cols;
+        --rows;
+      }
+      _row += rows * static_cast<difference_type>(_stride);
+      _col = static_cast<size_t>(pos);
       return *this;
     }
 
-    base_col_iterator& operator-=(const difference_type& other) {
-      _current -= other * static_cast<difference_type>(_cols);
-      return *this;
+    base_iterator& operator-=(const difference_type& other) {
+      return *this += -other;
     }
 
-    friend base_col_iterator operator+(const base_col_iterator& left, const difference_type& right) {
-      base_col_iterator res = left;
+    friend base_iterator operator+(const base_iterator& left, const difference_type& right) {
+      base_iterator res = left;
       res += right;
       return res;
     }
 
-    friend base_col_iterator operator+(const difference_type& left, const base_col_iterator& right) {
+    friend base_iterator operator+(const difference_type& left, const base_iterator& right) {
       return right + left;
     }
 
-    friend base_col_iterator operator-(const base_col_iterator& left, const difference_type& right) {
-      base_col_iterator res = left;
+    friend base_iterator operator-(const base_iterator& left, const difference_type& right) {
+      base_iterator res = left;
       res -= right;
       return res;
     }
 
-    friend difference_type operator-(const base_col_iterator& left, const base_col_iterator& right) {
-      return (left._current - right._current) / static_cast<difference_type>(left._cols);
+    friend difference_type operator-(const base_iterator& left, const base_iterator& right) {
+      difference_type cols = static_cast<difference_type>(left._col) - static_cast<difference_type>(right._col);
+      if (left._row == right._row) {
+        return cols;
+      }
+      difference_type rows = (left._row - right._row) / static_cast<difference_type>(left._stride);
+      return rows * static_cast<difference_type>(left._cols) + cols;
     }
 
     reference operator[](difference_type other) const {
       return *(*this + other);
     }
 
-    friend bool operator==(const base_col_iterator& lhs, const base_col_iterator& rhs) {
-      return lhs._current == rhs._current;
+    friend bool operator==(const base_iterator& lhs, const base_iterator& rhs) {
+      return lhs._row == rhs._row && lhs._col == rhs._col;
     }
 
-    friend bool operator!=(const base_col_iterator& lhs, const base_col_iterator& rhs) {
+    friend bool operator!=(const base_iterator& lhs, const base_iterator& rhs) {
       return !(lhs == rhs);
     }
 
-    friend bool operator<(const base_col_iterator& lhs, const base_col_iterator& rhs) {
-      return lhs._current < rhs._current;
+    friend bool operator<(const base_iterator& lhs, const base_iterator& rhs) {
+      return lhs._row < rhs._row || (lhs._row == rhs._row && lhs._col < rhs._col);
     }
 
-    friend bool operator<=(const base_col_iterator& lhs, const base_col_iterator& rhs) {
+    friend bool operator<=(const base_iterator& lhs, const base_iterator& rhs) {
       return lhs < rhs || lhs == rhs;
     }
 
-    friend bool operator>(const base_col_iterator& lhs, const base_col_iterator& rhs) {
+    friend bool operator>(const base_iterator& lhs, const base_iterator& rhs) {
       return !(lhs <= rhs);
     }
 
-    friend bool operator>=(const base_col_iterator& lhs, const base_col_iterator& rhs) {
+    friend bool operator>=(const base_iterator& lhs, const base_iterator& rhs) {
       return !(lhs < rhs);
     }
 
   private:
-    pointer _current;
-    size_t _cols;
+    pointer _row;
     size_t _col;
+    size_t _cols;
+    size_t _stride;
 
     friend matrix;
 
-    base_col_iterator(pointer current, size_t cols, size_t col) : _current(current), _cols(cols), _col(col) {}
+    base_iterator(pointer row, size_t col, size_t cols, size_t stride)
+        : _row(row), _col(col), _cols(cols), _stride(stride) {}
   };
 
+
 public:
   using value_type = T;
 
@@ -131,80 +480,158 @@ public:
   using pointer = T*;
   using const_pointer = const T*;
 
-  using iterator = pointer;
-  using const_iterator = const_pointer;
+  using iterator = base_iterator<T>;
+  using const_iterator = base_iterator<const T>;
 
   using row_iterator = pointer;
   using const_row_iterator = const_pointer;
 
-  using col_iterator = base_col_iterator<T>;
-  using const_col_iterator = base_col_iterator<const T>;
+  using col_iterator = matrix_col_iterator<T>;
+  using const_col_iterator = matrix_col_iterator<const T>;
 
-  matrix() : _rows(0), _cols(0), _data(nullptr) {}
+  using view = matrix_view<T>;
+  using const_view = matrix_view<const T>;
 
-  matrix(size_t rows, size_t cols)
-      : _rows(rows * cols == 0 ? 0 : rows),
-        _cols(rows * cols == 0 ? 0 : cols),
-        _data(empty() ? nullptr : new T[size()]()) {}
+  // Storage is aligned to this many bytes, a whole cache line and the widest vector matrix_simd
+  // dispatches to; rows of a padded matrix start on such boundaries too
+  static constexpr size_t alignment = std::max<size_t>(64, alignof(T));
+
+  matrix() : _rows(0), _cols(0), _stride(0), _layout(matrix_layout::packed), _data(nullptr) {}
+
+  matrix(size_t rows, size_t cols, matrix_layout layout = matrix_layout::packed)
+      : matrix(rows, cols, layout, for_overwrite) {
+    std::uninitialized_value_construct_n(_data, storage_size());
+  }
 
   template <size_t Rows, size_t Cols>
-  matrix(const T (&init)[Rows][Cols]) : _rows(Rows),
-                                        _cols(Cols),
-                                        _data(new T[size()]) {
+  matrix(const T (&init)[Rows][Cols]) : matrix(Rows, Cols, matrix_layout::packed, for_overwrite) {
     for (size_t row = 0; row < _rows; ++row) {
-      std::copy_n(init[row], _cols, _data + _cols * row);
+      std::uninitialized_copy_n(init[row], _cols, _data + _stride * row);
     }
   }
 
-  matrix(const matrix& other) : _rows(other._rows), _cols(other._cols), _data(empty() ? nullptr : new T[size()]) {
-    std::copy(other.begin(), other.end(), begin());
+  matrix(const matrix& other) : matrix(other._rows, other._cols, other._layout, for_overwrite) {
+    std::uninitialized_copy_n(other._data, storage_size(), _data);
+  }
+
+  matrix(matrix&& other) noexcept
+      : _rows(other._rows),
+        _cols(other._cols),
+        _stride(other._stride),
+        _layout(other._layout),
+        _data(other._data) {
+    other._rows = 0;
+    other._cols = 0;
+    other._stride = 0;
+    other._data = nullptr;
+  }
+
+  template <matrix_expr::node E>
+  matrix(const E& e, matrix_layout layout = matrix_layout::packed)
+      : matrix(e.rows(), e.cols(), layout, for_overwrite) {
+    construct_for_overwrite();
+    matrix_expr::evaluate(e, data(), _stride, matrix_expr::assign_op::assign);
+  }
+
+  explicit matrix(const const_view& v, matrix_layout layout = matrix_layout::packed)
+      : matrix(v.rows(), v.cols(), layout, for_overwrite) {
+    for (size_t row = 0; row < _rows; ++row) {
+      std::uninitialized_copy(v.row_begin(row), v.row_end(row), _data + _stride * row);
+      std::uninitialized_value_construct(_data + _stride * row + _cols, _data + _stride * (row + 1));
+    }
   }
 
+  // Reuses the buffer when it has the same size, takes the layout of other
   matrix& operator=(const matrix& other) {
     if (this == &other) {
       return *this;
     }
-    matrix copy = other;
-    swap(*this, copy);
+    if (storage_size() == other.storage_size()) {
+      std::copy_n(other._data, storage_size(), _data);
+      _rows = other._rows;
+      _cols = other._cols;
+      _stride = other._stride;
+      _layout = other._layout;
+    } else {
+      matrix copy = other;
+      swap(*this, copy);
+    }
+    return *this;
+  }
+
+  matrix& operator=(matrix&& other) noexcept {
+    matrix tmp = std::move(other);
+    swap(*this, tmp);
+    return *this;
+  }
+
+  // Evaluated in place when the buffer fits the result exactly, the expression may refer to this
+  // matrix. The layout is kept.
+  template <matrix_expr::node E>
+  matrix& operator=(const E& e) {
+    size_t stride = stride_for(e.cols(), _layout);
+    // padding that moved would no longer hold value-initialized elements
+    if (!e.empty() && e.rows() * stride == storage_size() && (stride == _stride || _layout == matrix_layout::packed)) {
+      size_t cols = _cols;
+      _stride = stride;
+      _rows = e.rows();
+      _cols = e.cols();
+      matrix_expr::evaluate(e, data(), _stride, matrix_expr::assign_op::assign);
+      // columns that became padding are reset last, the expression may have read them
+      for (size_t row = 0; _layout == matrix_layout::padded && _cols < cols && row < _rows; ++row) {
+        std::fill(row_begin(row) + _cols, row_begin(row) + cols, T());
+      }
+    } else {
+      matrix tmp(e, _layout);
+      swap(*this, tmp);
+    }
     return *this;
   }
 
+  // The view may be a part of this matrix
+  matrix& operator=(const const_view& v) {
+    return *this = matrix_expr::wrap(v);
+  }
+
   ~matrix() {
-    delete[] _data;
+    std::destroy_n(_data, storage_size());
+    deallocate(_data);
   }
 
   friend void swap(matrix& lhs, matrix& rhs) {
     std::swap(lhs._cols, rhs._cols);
     std::swap(lhs._rows, rhs._rows);
+    std::swap(lhs._stride, rhs._stride);
+    std::swap(lhs._layout, rhs._layout);
     std::swap(lhs._data, rhs._data);
   }
 
   // Iterators
 
   iterator begin() {
-    return data();
+    return {_data, 0, _cols, _stride};
   }
 
   const_iterator begin() const {
-    return data();
+    return {_data, 0, _cols, _stride};
   }
 
   iterator end() {
-    return begin() + size();
+    return {_data + _rows * _stride, 0, _cols, _stride};
   }
 
   const_iterator end() const {
-    return begin() + size();
+    return {_data + _rows * _stride, 0, _cols, _stride};
   }
 
   row_iterator row_begin(size_t row) {
     assert(row < _rows);
-    return data() + row * _cols;
+    return data() + row * _stride;
   }
 
   const_row_iterator row_begin(size_t row) const {
     assert(row < _rows);
-    return data() + row * _cols;
+    return data() + row * _stride;
   }
 
   row_iterator row_end(size_t row) {
@@ -217,12 +644,12 @@ public:
 
   col_iterator col_begin(size_t col) {
     assert(col < _cols);
-    return {begin(), _cols, col};
+    return {data(), _stride, col};
   }
 
   const_col_iterator col_begin(size_t col) const {
     assert(col < _cols);
-    return {begin(), _cols, col};
+    return {data(), _stride, col};
   }
 
   col_iterator col_end(size_t col) {
@@ -251,18 +678,28 @@ public:
     return size() == 0;
   }
 
+  // Distance between the starts of consecutive rows in data(), in elements
+  size_t stride() const {
+    return _stride;
+  }
+
+  matrix_layout layout() const {
+    return _layout;
+  }
+
   // Elements access
 
   reference operator()(size_t row, size_t col) {
     assert(row < _rows && col < _cols);
-    return _data[row * _cols + col];
+    return _data[row * _stride + col];
   }
 
   const_reference operator()(size_t row, size_t col) const {
     assert(row < _rows && col < _cols);
-    return _data[row * _cols + col];
+    return _data[row * _stride + col];
   }
 
+  // Row row starts at data() + row * stride()
   pointer data() {
     return _data;
   }
@@ -271,16 +708,59 @@ public:
     return _data;
   }
 
+  // Views
+
+  operator view() {
+    return {_data, _rows, _cols, _stride};
+  }
+
+  operator const_view() const {
+    return {_data, _rows, _cols, _stride};
+  }
+
+  view submatrix(size_t row, size_t col, size_t rows, size_t cols) {
+    return view(*this).submatrix(row, col, rows, cols);
+  }
+
+  const_view submatrix(size_t row, size_t col, size_t rows, size_t cols) const {
+    return const_view(*this).submatrix(row, col, rows, cols);
+  }
+
+  // Transpose
+
+  matrix transposed() const {
+    matrix res(_cols, _rows, _layout, for_overwrite);
+    res.construct_for_overwrite();
+    ::transpose<T>(*this, res);
+    return res;
+  }
+
+  // In place for square matrices, through a new buffer otherwise
+  matrix& transpose() {
+    if (_rows == _cols) {
+      ::transpose<T>(*this);
+    } else {
+      matrix tmp = transposed();
+      swap(*this, tmp);
+    }
+    return *this;
+  }
+
   // Comparison
 
   friend bool operator==(const matrix& left, const matrix& right) {
     if (left.size() == 0 && right.size() == 0) {
       return true;
     }
-    if (left._cols == right._cols && left._rows == right._rows) {
-      return std::equal(left.begin(), left.end(), right.begin());
+    if (left._cols != right._cols || left._rows != right._rows) {
+      return false;
+    }
+    for (size_t row = 0; row < left._rows; ++row) {
+      if (!matrix_simd::equal(left.row_begin(row), right.row_begin(row), left._cols)) {
+        return false;
+      }
     }
-    return false;
+    return true;
   }
 
   friend bool operator!=(const matrix& left, const matrix& right) {
@@ -291,64 +771,227 @@ public:
 
   matrix& operator+=(const matrix& other) {
     assert(_cols == other.cols() && _rows == other.rows());
-    std::transform(begin(), end(), other.begin(), begin(), std::plus<T>());
+    for_each_span(contiguous() && other.contiguous(), [&](size_t row, size_t col, size_t count) {
+      matrix_simd::transform(row_begin(row) + col, other.row_begin(row) + col, count, matrix_simd::add());
+    });
     return *this;
   }
 
   matrix& operator-=(const matrix& other) {
     assert(_cols == other.cols() && _rows == other.rows());
-    std::transform(begin(), end(), other.begin(), begin(), std::minus<T>());
+    for_each_span(contiguous() && other.contiguous(), [&](size_t row, size_t col, size_t count) {
+      matrix_simd::transform(row_begin(row) + col, other.row_begin(row) + col, count, matrix_simd::subtract());
+    });
+    return *this;
+  }
+
+  template <matrix_expr::operand E>
+  matrix& operator+=(const E& e) {
+    assert(_cols == e.cols() && _rows == e.rows());
+    matrix_expr::evaluate(matrix_expr::wrap(e), data(), _stride, matrix_expr::assign_op::add);
+    return *this;
+  }
+
+  template <matrix_expr::operand E>
+  matrix& operator-=(const E& e) {
+    assert(_cols == e.cols() && _rows == e.rows());
+    matrix_expr::evaluate(matrix_expr::wrap(e), data(), _stride, matrix_expr::assign_op::subtract);
     return *this;
   }
 
   matrix& operator*=(const matrix& other) {
-    matrix tmp = *this * other;
+    matrix tmp(*this * other, _layout);
     swap(*this, tmp);
     return *this;
   }
 
   matrix& operator*=(const_reference factor) {
-    std::transform(begin(), end(), begin(), [&factor](reference a) { return a * factor; });
+    for_each_span(contiguous(), [&](size_t row, size_t col, size_t count) {
+      matrix_simd::transform(row_begin(row) + col, count, matrix_simd::scale<T>{factor});
+    });
     return *this;
   }
 
-  friend matrix operator+(const matrix& left, const matrix& right) {
-    matrix res = left;
-    res += right;
-    return res;
+  // this += alpha * other
+  matrix& axpy(const_reference alpha, const matrix& other) {
+    assert(_cols == other.cols() && _rows == other.rows());
+    for_each_span(contiguous() && other.contiguous(), [&](size_t row, size_t col, size_t count) {
+      matrix_simd::transform(row_begin(row) + col, other.row_begin(row) + col, count, matrix_simd::add_scaled<T>{alpha});
+    });
+    return *this;
   }
 
-  friend matrix operator-(const matrix& left, const matrix& right) {
-    matrix res = left;
-    res -= right;
-    return res;
+  // Elementwise product and quotient
+  matrix& multiply_elements(const matrix& other) {
+    assert(_cols == other.cols() && _rows == other.rows());
+    for_each_span(contiguous() && other.contiguous(), [&](size_t row, size_t col, size_t count) {
+      matrix_simd::transform(row_begin(row) + col, other.row_begin(row) + col, count, matrix_simd::multiply());
+    });
+    return *this;
   }
 
-  friend matrix operator*(const matrix& left, const matrix& right) {
-    assert(left.cols() == right.rows());
-    matrix res(left.rows(), right.cols());
-    for (size_t row = 0; row < left.rows(); ++row) {
-      for (size_t col = 0; col < right.cols(); ++col) {
-        res(row, col) = std::inner_product(left.row_begin(row), left.row_end(row), right.col_begin(col), T());
-      }
-    }
-    return res;
+  matrix& divide_elements(const matrix& other) {
+    assert(_cols == other.cols() && _rows == other.rows());
+    for_each_span(contiguous() && other.contiguous(), [&](size_t row, size_t col, size_t count) {
+      matrix_simd::transform(row_begin(row) + col, other.row_begin(row) + col, count, matrix_simd::divide());
+    });
+    return *this;
   }
 
-  friend matrix operator*(const matrix& left, value_type right) {
-    matrix res = left;
-    res *= right;
-    return res;
+  // Reductions, fixed chunks of elements are reduced separately and then in order, so the result does
+  // not depend on the number of threads or the layout. Over an empty matrix min() is
+  // std::numeric_limits<T>::max() and max() is std::numeric_limits<T>::lowest(), the identities of the
+  // two operations for arithmetic types.
+
+  T sum() const {
+    return empty() ? T() : reduce(matrix_simd::sum());
   }
 
-  friend matrix operator*(value_type left, const matrix& right) {
-    matrix res = right;
-    res *= left;
-    return res;
+  T min() const {
+    return empty() ? std::numeric_limits<T>::max() : reduce(matrix_simd::min());
+  }
+
+  T max() const {
+    return empty() ? std::numeric_limits<T>::lowest() : reduce(matrix_simd::max());
+  }
+
+  T squared_norm() const {
+    return empty() ? T() : reduce(matrix_simd::sum_of_squares());
+  }
+
+  // Frobenius norm
+  T norm() const
+    requires std::is_floating_point_v<T>
+  {
+    return std::sqrt(squared_norm());
   }
 
 private:
   size_t _rows;
   size_t _cols;
+  size_t _stride;
+  matrix_layout _layout;
   pointer _data;
+
+  friend class matrix_expr::product_node<T>;
+
+  struct for_overwrite_t {};
+  static constexpr for_overwrite_t for_overwrite{};
+
+  // Allocates storage for rows x cols elements in the layout without constructing them
+  matrix(size_t rows, size_t cols, matrix_layout layout, for_overwrite_t)
+      : _rows(rows * cols == 0 ? 0 : rows),
+        _cols(rows * cols == 0 ? 0 : cols),
+        _stride(stride_for(_cols, layout)),
+        _layout(layout),
+        _data(allocate(storage_size())) {}
+
+  matrix(size_t rows, size_t cols, for_overwrite_t) : matrix(rows, cols, matrix_layout::packed, for_overwrite) {}
+
+  // Default-initializes the elements of a for_overwrite matrix that is about to be written in full,
+  // which leaves trivial types uninitialized. The padding is value-initialized.
+  void construct_for_overwrite() {
+    if (_stride == _cols) {
+      std::uninitialized_default_construct_n(_data, storage_size());
+      return;
+    }
+    for (size_t row = 0; row < _rows; ++row) {
+      std::uninitialized_default_construct_n(_data + _stride * row, _cols);
+      std::uninitialized_value_construct(_data + _stride * row + _cols, _data + _stride * (row + 1));
+    }
+  }
+
+  // Number of elements in the buffer, padding included
+  size_t storage_size() const {
+    return _rows * _stride;
+  }
+
+  // Padded rows are rounded up to a multiple of alignment bytes
+  static size_t stride_for(size_t cols, matrix_layout layout) {
+    if (layout == matrix_layout::packed) {
+      return cols;
+    }
+    size_t step = alignment / std::gcd(alignment, sizeof(T));
+    return (cols + step - 1) / step * step;
+  }
+
+  static pointer allocate(size_t count) {
+    if (count == 0) {
+      return nullptr;
+    }
+    return static_cast<pointer>(::operator new(count * sizeof(T), std::align_val_t(alignment)));
+  }
+
+  static void deallocate(pointer data) {
+    ::operator delete(data, std::align_val_t(alignment));
+  }
+
+  // dst (m x n) = a (m x k) * b (k x n), or dst += a * b if accumulate; ld* are the row strides
+  static void multiply(size_t m, size_t n, size_t k, const_pointer a, size_t lda, const_pointer b, size_t ldb,
+                       pointer dst, size_t ldc, bool accumulate) {
+    if constexpr (matrix_gemm::enabled<T>) {
+      matrix_gemm::gemm(m, n, k, a, lda, b, ldb, dst, ldc, accumulate);
+    } else {
+      for (size_t row = 0; row < m; ++row) {
+        for (size_t col = 0; col < n; ++col) {
+          const_col_iterator b_col = {b, ldb, col};
+          T sum = std::inner_product(a + row * lda, a + row * lda + k, b_col, T());
+          dst[row * ldc + col] = accumulate ? dst[row * ldc + col] + sum : sum;
+        }
+      }
+    }
+  }
+
+  // Rows follow each other without gaps
+  bool contiguous() const {
+    return _stride == _cols;
+  }
+
+  // Elementwise work is split on cache lines of the storage, f(row, col, count) handles a piece of a
+  // row. If every matrix involved is contiguous (flat), the elements are handed out as one long row.
+  template <class F>
+  void for_each_span(bool flat, F f) const {
+    if (flat) {
+      matrix_parallel::for_each_span<T>(1, size(), size(), f);
+    } else {
+      matrix_parallel::for_each_span<T>(_rows, _cols, _stride, f);
+    }
+  }
+
+  // Elements reduced into one partial result, the same for every layout and number of threads
+  static constexpr size_t reduce_chunk = 16 * 1024;
+
+  template <class Op>
+  T reduce(const Op& op) const {
+    assert(!empty());
+    size_t chunks = (size() + reduce_chunk - 1) / reduce_chunk;
+    std::unique_ptr<T[]> partial(new T[chunks]);
+    matrix_parallel::for_each_block(chunks, size(), 1, [&](size_t first, size_t last) {
+      for (size_t chunk = first; chunk < last; ++chunk) {
+        partial[chunk] = reduce(chunk * reduce_chunk, std::min(size(), (chunk + 1) * reduce_chunk), op);
+      }
+    });
+    T res = partial[0];
+    for (size_t chunk = 1; chunk < chunks; ++chunk) {
+      op.merge(res, partial[chunk]);
+    }
+    return res;
+  }
+
+  // Reduces the elements [first, last) in row-major order, first < last
+  template <class Op>
+  T reduce(size_t first, size_t last, const Op& op) const {
+    bool started = false;
+    T res = T();
+    matrix_parallel::for_each_piece(first, last, _cols, _cols, [&](size_t row, size_t col, size_t count) {
+      T part = matrix_simd::reduce(row_begin(row) + col, count, op);
+      if (started) {
+        op.merge(res, part);
+      } else {
+        res = part;
+        started = true;
+      }
+    });
+    return res;
+  }
 };
@@ -0,0 +1,456 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <numeric>
+#include <utility>
+
+#include "matrix.h"
+
+enum class sparse_format {
+  // compressed rows: the nonzeros of each row are stored together, sorted by column
+  csr,
+  // compressed columns: the nonzeros of each column are stored together, sorted by row
+  csc,
+};
+
+// Sparse matrix in compressed form. The major dimension is rows for CSR and columns for CSC: the
+// nonzeros of major line i are at [offsets()[i], offsets()[i + 1]) of indices(), which holds their
+// minor coordinates, and of values(). Elements that become zero in arithmetic stay stored.
+template <class T, sparse_format Format>
+class sparse_matrix {
+public:
+  using value_type = T;
+
+  static constexpr sparse_format format = Format;
+  static constexpr sparse_format transposed_format =
+      Format == sparse_format::csr ? sparse_format::csc : sparse_format::csr;
+
+  using transposed_type = sparse_matrix<T, transposed_format>;
+
+  // 0 x 0 without any storage, offsets() then points to a single zero
+  sparse_matrix() noexcept : _rows(0), _cols(0), _nonzeros(0) {}
+
+  // All zeros
+  sparse_matrix(size_t rows, size_t cols)
+      : sparse_matrix(rows, cols, std::make_unique<size_t[]>(line_of(rows, cols) + 1), nullptr, nullptr) {}
+
+  // From count coordinate triplets in any order, duplicates are summed in the order given
+  sparse_matrix(size_t rows, size_t cols, size_t count, const size_t* row_indices, const size_t* col_indices,
+                const T* values)
+      : sparse_matrix(rows, cols) {
+    size_t lines = line_of(rows, cols);
+    // bucket the triplets by major line, keeping their order
+    std::unique_ptr<size_t[]> offsets = std::make_unique<size_t[]>(lines + 1);
+    for (size_t i = 0; i < count; ++i) {
+      assert(row_indices[i] < rows && col_indices[i] < cols);
+      ++offsets[line_of(row_indices[i], col_indices[i]) + 1];
+    }
+    std::partial_sum(offsets.get(), offsets.get() + lines + 1, offsets.get());
+    std::unique_ptr<std::pair<size_t, T>[]> entries(new std::pair<size_t, T>[count]);
+    std::unique_ptr<size_t[]> next(new size_t[lines]);
+    std::copy_n(offsets.get(), lines, next.get());
+    for (size_t i = 0; i < count; ++i) {
+      entries[next[line_of(row_indices[i], col_indices[i])]++] = {index_of(row_indices[i], col_indices[i]), values[i]};
+    }
+    // sort every line by minor index and merge duplicates in place
+    size_t nonzeros = 0;
+    for (size_t line = 0; line < lines; ++line) {
+      size_t first = offsets[line];
+      size_t last = offsets[line + 1];
+      std::stable_sort(entries.get() + first, entries.get() + last,
+                       [](const auto& left, const auto& right) { return left.first < right.first; });
+      offsets[line] = nonzeros;
+      for (size_t i = first; i < last; ++i) {
+        if (nonzeros > offsets[line] && entries[nonzeros - 1].first == entries[i].first) {
+          entries[nonzeros - 1].second = entries[nonzeros - 1].second + entries[i].second;
+        } else {
+          entries[nonzeros++] = std::move(entries[i]);
+        }
+      }
+    }
+    offsets[lines] = nonzeros;
+    _offsets = std::move(offsets);
+    _nonzeros = nonzeros;
+    _indices.reset(new size_t[nonzeros]);
+    _values.reset(new T[nonzeros]);
+    for (size_t i = 0; i < nonzeros; ++i) {
+      _indices[i] = entries[i].first;
+      _values[i] = std::move(entries[i].second);
+    }
+  }
+
+  // Keeps the elements of dense that differ from T()
+  explicit sparse_matrix(const const_matrix_view<T>& dense) : sparse_matrix(dense.rows(), dense.cols()) {
+    size_t lines = line_of(_rows, _cols);
+    for (size_t line = 0; line < lines; ++line) {
+      _offsets[line + 1] = _offsets[line];
+      for (size_t i = 0; i < index_of(_rows, _cols); ++i) {
+        _offsets[line + 1] += !(element(dense, line, i) == T());
+      }
+    }
+    _nonzeros = _offsets[lines];
+    _indices.reset(new size_t[_nonzeros]);
+    _values.reset(new T[_nonzeros]);
+    for (size_t line = 0, pos = 0; line < lines; ++line) {
+      for (size_t i = 0; i < index_of(_rows, _cols); ++i) {
+        const T& value = element(dense, line, i);
+        if (!(value == T())) {
+          _indices[pos] = i;
+          _values[pos++] = value;
+        }
+      }
+    }
+  }
+
+  // Converts between CSR and CSC
+  explicit sparse_matrix(const transposed_type& other) : sparse_matrix(other.converted()) {}
+
+  sparse_matrix(const sparse_matrix& other)
+      : sparse_matrix(other._rows, other._cols, std::make_unique<size_t[]>(other.lines() + 1),
+                      std::make_unique<size_t[]>(other._nonzeros), std::make_unique<T[]>(other._nonzeros)) {
+    _nonzeros = other._nonzeros;
+    std::copy_n(other.offsets(), other.lines() + 1, _offsets.get());
+    std::copy_n(other._indices.get(), _nonzeros, _indices.get());
+    std::copy_n(other._values.get(), _nonzeros, _values.get());
+  }
+
+  sparse_matrix(sparse_matrix&& other) noexcept : sparse_matrix() {
+    swap(*this, other);
+  }
+
+  sparse_matrix& operator=(const sparse_matrix& other) {
+    if (this != &other) {
+      sparse_matrix copy = other;
+      swap(*this, copy);
+    }
+    return *this;
+  }
+
+  sparse_matrix& operator=(sparse_matrix&& other) noexcept {
+    sparse_matrix tmp = std::move(other);
+    swap(*this, tmp);
+    return *this;
+  }
+
+  friend void swap(sparse_matrix& lhs, sparse_matrix& rhs) noexcept {
+    std::swap(lhs._rows, rhs._rows);
+    std::swap(lhs._cols, rhs._cols);
+    std::swap(lhs._nonzeros, rhs._nonzeros);
+    std::swap(lhs._offsets, rhs._offsets);
+    std::swap(lhs._indices, rhs._indices);
+    std::swap(lhs._values, rhs._values);
+  }
+
+  matrix<T> to_dense() const {
+    matrix<T> res(_rows, _cols);
+    for (size_t line = 0; line < lines(); ++line) {
+      for (size_t pos = _offsets[line]; pos < _offsets[line + 1]; ++pos) {
+        element(res, line, _indices[pos]) = _values[pos];
+      }
+    }
+    return res;
+  }
+
+  // The same storage read in the other format
+  transposed_type transposed() const {
+    sparse_matrix copy = *this;
+    return transposed_type(copy._cols, copy._rows, std::move(copy._offsets), std::move(copy._indices),
+                           std::move(copy._values), copy._nonzeros);
+  }
+
+  // Size
+
+  size_t rows() const {
+    return _rows;
+  }
+
+  size_t cols() const {
+    return _cols;
+  }
+
+  // Number of stored elements
+  size_t nonzeros() const {
+    return _nonzeros;
+  }
+
+  // Elements access
+
+  // Binary search in the line, T() for an element that is not stored
+  T operator()(size_t row, size_t col) const {
+    assert(row < _rows && col < _cols);
+    size_t line = line_of(row, col);
+    const size_t* first = _indices.get() + _offsets[line];
+    const size_t* last = _indices.get() + _offsets[line + 1];
+    const size_t* it = std::lower_bound(first, last, index_of(row, col));
+    return it != last && *it == index_of(row, col) ? _values[it - _indices.get()] : T();
+  }
+
+  const size_t* offsets() const {
+    return _offsets ? _offsets.get() : no_offsets;
+  }
+
+  const size_t* indices() const {
+    return _indices.get();
+  }
+
+  T* values() {
+    return _values.get();
+  }
+
+  const T* values() const {
+    return _values.get();
+  }
+
+  // Products
+
+  // y = A * x, x has cols() elements and y rows(). CSR rows are computed in parallel in blocks of
+  // about the same number of nonzeros, CSC scatters into y on the calling thread.
+  void multiply(const T* x, T* y) const {
+    if constexpr (Format == sparse_format::csr) {
+      for_each_line_block(offsets(), _rows, _nonzeros, [&](size_t first, size_t last) {
+        for (size_t row = first; row < last; ++row) {
+          T sum = T();
+          for (size_t pos = _offsets[row]; pos < _offsets[row + 1]; ++pos) {
+            sum = sum + _values[pos] * x[_indices[pos]];
+          }
+          y[row] = sum;
+        }
+      });
+    } else {
+      std::fill_n(y, _rows, T());
+      for (size_t col = 0; col < _cols; ++col) {
+        for (size_t pos = _offsets[col]; pos < _offsets[col + 1]; ++pos) {
+          y[_indices[pos]] = y[_indices[pos]] + _values[pos] * x[col];
+        }
+      }
+    }
+  }
+
+  // A * dense: every nonzero (i, k) adds a row of dense to row i of the result
+  friend matrix<T> operator*(const sparse_matrix& left, const const_matrix_view<T>& right) {
+    assert(left._cols == right.rows());
+    matrix<T> res(left._rows, right.cols());
+    if (right.cols() == 1 && right.rows() > 0 && res.stride() == 1 && right.contiguous()) {
+      left.multiply(right.data(), res.data());
+      return res;
+    }
+    auto add_row = [&](size_t row, size_t pos, size_t k) {
+      matrix_simd::transform(res.row_begin(row), right.row_begin(k), right.cols(),
+                             matrix_simd::add_scaled<T>{left._values[pos]});
+    };
+    if constexpr (Format == sparse_format::csr) {
+      size_t operations = left._nonzeros * right.cols();
+      for_each_line_block(left.offsets(), left._rows, operations, [&](size_t first, size_t last) {
+        for (size_t row = first; row < last; ++row) {
+          for (size_t pos = left._offsets[row]; pos < left._offsets[row + 1]; ++pos) {
+            add_row(row, pos, left._indices[pos]);
+          }
+        }
+      });
+    } else {
+      for (size_t k = 0; k < left._cols; ++k) {
+        for (size_t pos = left._offsets[k]; pos < left._offsets[k + 1]; ++pos) {
+          add_row(left._indices[pos], pos, k);
+        }
+      }
+    }
+    return res;
+  }
+
+  friend matrix<T> operator*(const sparse_matrix& left, const matrix<T>& right) {
+    return left * const_matrix_view<T>(right);
+  }
+
+  // dense * A, computed by rows of dense in parallel
+  friend matrix<T> operator*(const const_matrix_view<T>& left, const sparse_matrix& right) {
+    assert(left.cols() == right._rows);
+    matrix<T> res(left.rows(), right._cols);
+    matrix_parallel::for_each_block(left.rows(), left.rows() * right._nonzeros, 1, [&](size_t first, size_t last) {
+      for (size_t row = first; row < last; ++row) {
+        T* out = res.row_begin(row);
+        for (size_t line = 0; line < right.lines(); ++line) {
+          for (size_t pos = right._offsets[line]; pos < right._offsets[line + 1]; ++pos) {
+            size_t k = Format == sparse_format::csr ? line : right._indices[pos];
+            size_t col = Format == sparse_format::csr ? right._indices[pos] : line;
+            out[col] = out[col] + left(row, k) * right._values[pos];
+          }
+        }
+      }
+    });
+    return res;
+  }
+
+  friend matrix<T> operator*(const matrix<T>& left, const sparse_matrix& right) {
+    return const_matrix_view<T>(left) * right;
+  }
+
+  // Sparse product in the format of the left operand, the right one is converted to it first
+  template <sparse_format Other>
+  friend sparse_matrix operator*(const sparse_matrix& left, const sparse_matrix<T, Other>& right) {
+    assert(left._cols == right.rows());
+    if constexpr (Other != Format) {
+      return left * sparse_matrix(right);
+    } else if constexpr (Format == sparse_format::csr) {
+      return multiply_rows(left, right, left._rows, right._cols);
+    } else {
+      // in CSC storage A * B is read as the CSR storage of B^T * A^T
+      return multiply_rows(right, left, left._rows, right._cols);
+    }
+  }
+
+  friend bool operator==(const sparse_matrix& left, const sparse_matrix& right) {
+    return left._rows == right._rows && left._cols == right._cols && left._nonzeros == right._nonzeros &&
+           std::equal(left.offsets(), left.offsets() + left.lines() + 1, right.offsets()) &&
+           std::equal(left._indices.get(), left._indices.get() + left._nonzeros, right._indices.get()) &&
+           std::equal(left._values.get(), left._values.get() + left._nonzeros, right._values.get());
+  }
+
+  friend bool operator!=(const sparse_matrix& left, const sparse_matrix& right) {
+    return !(left == right);
+  }
+
+private:
+  size_t _rows;
+  size_t _cols;
+  size_t _nonzeros;
+  // null only in a default-constructed or moved-from matrix, which has no lines
+  std::unique_ptr<size_t[]> _offsets;
+  std::unique_ptr<size_t[]> _indices;
+  std::unique_ptr<T[]> _values;
+
+  static constexpr size_t no_offsets[1] = {};
+
+  template <class, sparse_format>
+  friend class sparse_matrix;
+
+  sparse_matrix(size_t rows, size_t cols, std::unique_ptr<size_t[]> offsets, std::unique_ptr<size_t[]> indices,
+                std::unique_ptr<T[]> values, size_t nonzeros = 0)
+      : _rows(rows),
+        _cols(cols),
+        _nonzeros(nonzeros),
+        _offsets(std::move(offsets)),
+        _indices(std::move(indices)),
+        _values(std::move(values)) {}
+
+  // Major and minor coordinates of an element
+  static size_t line_of(size_t row, size_t col) {
+    return Format == sparse_format::csr ? row : col;
+  }
+
+  static size_t index_of(size_t row, size_t col) {
+    return Format == sparse_format::csr ? col : row;
+  }
+
+  size_t lines() const {
+    return line_of(_rows, _cols);
+  }
+
+  template <class M>
+  static auto& element(M& m, size_t line, size_t i) {
+    return Format == sparse_format::csr ? m(line, i) : m(i, line);
+  }
+
+  // The same matrix in the other format: a counting sort by minor index, which visits the major
+  // lines in order and so keeps every new line sorted
+  transposed_type converted() const {
+    size_t minors = index_of(_rows, _cols);
+    std::unique_ptr<size_t[]> offsets = std::make_unique<size_t[]>(minors + 1);
+    std::unique_ptr<size_t[]> indices(new size_t[_nonzeros]);
+    std::unique_ptr<T[]> values(new T[_nonzeros]);
+    for (size_t pos = 0; pos < _nonzeros; ++pos) {
+      ++offsets[_indices[pos] + 1];
+    }
+    std::partial_sum(offsets.get(), offsets.get() + minors + 1, offsets.get());
+    std::unique_ptr<size_t[]> next(new size_t[minors]);
+    std::copy_n(offsets.get(), minors, next.get());
+    for (size_t line = 0; line < lines(); ++line) {
+      for (size_t pos = _offsets[line]; pos < _offsets[line + 1]; ++pos) {
+        size_t dst = next[_indices[pos]]++;
+        indices[dst] = line;
+        values[dst] = _values[pos];
+      }
+    }
+    return transposed_type(_rows, _cols, std::move(offsets), std::move(indices), std::move(values), _nonzeros);
+  }
+
+  // Splits lines [0, lines) into blocks holding about the same number of nonzeros and calls
+  // f(first, last) for each on the shared pool
+  template <class F>
+  static void for_each_line_block(const size_t* offsets, size_t lines, size_t operations, F f) {
+    size_t nonzeros = offsets[lines];
+    matrix_parallel::for_each_block(nonzeros, operations, 1, [&](size_t first, size_t last) {
+      size_t begin = std::lower_bound(offsets, offsets + lines, first) - offsets;
+      size_t end = last == nonzeros ? lines : std::lower_bound(offsets, offsets + lines, last) - offsets;
+      f(begin, end);
+    });
+  }
+
+  // Row-by-row (Gustavson) product of the compressed storages of a (m lines) and b (n minor
+  // indices): a symbolic pass counts the nonzeros of every line of the result, a numeric pass fills
+  // them in with a dense accumulator. Lines are split over the pool, each block with its own
+  // accumulator.
+  static sparse_matrix multiply_rows(const sparse_matrix& a, const sparse_matrix& b, size_t rows, size_t cols) {
+    size_t m = a.lines();
+    size_t n = index_of(b._rows, b._cols);
+    std::unique_ptr<size_t[]> offsets = std::make_unique<size_t[]>(m + 1);
+    size_t operations = a._nonzeros + b._nonzeros;
+    for_each_line_block(a.offsets(), m, operations, [&](size_t first, size_t last) {
+      std::unique_ptr<size_t[]> marker(new size_t[n]);
+      std::fill_n(marker.get(), n, m);
+      for (size_t line = first; line < last; ++line) {
+        size_t count = 0;
+        for (size_t pos = a._offsets[line]; pos < a._offsets[line + 1]; ++pos) {
+          size_t k = a._indices[pos];
+          for (size_t other = b._offsets[k]; other < b._offsets[k + 1]; ++other) {
+            if (marker[b._indices[other]] != line) {
+              marker[b._indices[other]] = line;
+              ++count;
+            }
+          }
+        }
+        offsets[line + 1] = count;
+      }
+    });
+    std::partial_sum(offsets.get(), offsets.get() + m + 1, offsets.get());
+    size_t nonzeros = offsets[m];
+    std::unique_ptr<size_t[]> indices(new size_t[nonzeros]);
+    std::unique_ptr<T[]> values(new T[nonzeros]);
+    for_each_line_block(a.offsets(), m, operations, [&](size_t first, size_t last) {
+      std::unique_ptr<size_t[]> marker(new size_t[n]);
+      std::unique_ptr<T[]> accumulator(new T[n]);
+      std::fill_n(marker.get(), n, m);
+      for (size_t line = first; line < last; ++line) {
+        size_t* line_indices = indices.get() + offsets[line];
+        size_t count = 0;
+        for (size_t pos = a._offsets[line]; pos < a._offsets[line + 1]; ++pos) {
+          size_t k = a._indices[pos];
+          for (size_t other = b._offsets[k]; other < b._offsets[k + 1]; ++other) {
+            size_t j = b._indices[other];
+            T product = a._values[pos] * b._values[other];
+            if (marker[j] != line) {
+              marker[j] = line;
+              accumulator[j] = product;
+              line_indices[count++] = j;
+            } else {
+              accumulator[j] = accumulator[j] + product;
+            }
+          }
+        }
+        std::sort(line_indices, line_indices + count);
+        for (size_t i = 0; i < count; ++i) {
+          values[offsets[line] + i] = accumulator[line_indices[i]];
+        }
+      }
+    });
+    return sparse_matrix(rows, cols, std::move(offsets), std::move(indices), std::move(values), nonzeros);
+  }
+};
+
+template <class T>
+using csr_matrix = sparse_matrix<T, sparse_format::csr>;
+
+template <class T>
+using csc_matrix = sparse_matrix<T, sparse_format::csc>;
@@ -0,0 +1,279 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+
+#include "matrix.h"
+
+// Matrix with its size fixed at compile time and the elements stored inline, for the small
+// matrices of geometry and physics code. Arithmetic is constexpr and its loops are unrolled, so a
+// product is a straight sequence of multiply-adds. A static_matrix converts to matrix_view, takes
+// part in expressions and products with matrix, and is built from or into a matrix of the same size.
+template <class T, size_t Rows, size_t Cols>
+class static_matrix {
+  static_assert(Rows > 0 && Cols > 0);
+
+public:
+  using value_type = T;
+
+  using reference = T&;
+  using const_reference = const T&;
+
+  using pointer = T*;
+  using const_pointer = const T*;
+
+  using iterator = pointer;
+  using const_iterator = const_pointer;
+
+  using row_iterator = pointer;
+  using const_row_iterator = const_pointer;
+
+  using col_iterator = matrix_col_iterator<T>;
+  using const_col_iterator = matrix_col_iterator<const T>;
+
+  using view = matrix_view<T>;
+  using const_view = matrix_view<const T>;
+
+  constexpr static_matrix() : _data() {}
+
+  constexpr static_matrix(const T (&init)[Rows][Cols]) : _data() {
+    for (size_t row = 0; row < Rows; ++row) {
+      std::copy(init[row], init[row] + Cols, row_begin(row));
+    }
+  }
+
+  explicit static_matrix(const const_view& other) : _data() {
+    assert(other.rows() == Rows && other.cols() == Cols);
+    for (size_t row = 0; row < Rows; ++row) {
+      std::copy(other.row_begin(row), other.row_end(row), row_begin(row));
+    }
+  }
+
+  static constexpr static_matrix identity()
+    requires (Rows == Cols)
+  {
+    static_matrix res;
+    for (size_t i = 0; i < Rows; ++i) {
+      res(i, i) = T(1);
+    }
+    return res;
+  }
+
+  // Iterators
+
+  constexpr iterator begin() {
+    return _data;
+  }
+
+  constexpr const_iterator begin() const {
+    return _data;
+  }
+
+  constexpr iterator end() {
+    return _data + Rows * Cols;
+  }
+
+  constexpr const_iterator end() const {
+    return _data + Rows * Cols;
+  }
+
+  constexpr row_iterator row_begin(size_t row) {
+    assert(row < Rows);
+    return _data + row * Cols;
+  }
+
+  constexpr const_row_iterator row_begin(size_t row) const {
+    assert(row < Rows);
+    return _data + row * Cols;
+  }
+
+  constexpr row_iterator row_end(size_t row) {
+    return row_begin(row) + Cols;
+  }
+
+  constexpr const_row_iterator row_end(size_t row) const {
+    return row_begin(row) + Cols;
+  }
+
+  col_iterator col_begin(size_t col) {
+    assert(col < Cols);
+    return {_data, Cols, col};
+  }
+
+  const_col_iterator col_begin(size_t col) const {
+    assert(col < Cols);
+    return {_data, Cols, col};
+  }
+
+  col_iterator col_end(size_t col) {
+    return col_begin(col) + Rows;
+  }
+
+  const_col_iterator col_end(size_t col) const {
+    return col_begin(col) + Rows;
+  }
+
+  // Size
+
+  static constexpr size_t rows() {
+    return Rows;
+  }
+
+  static constexpr size_t cols() {
+    return Cols;
+  }
+
+  static constexpr size_t size() {
+    return Rows * Cols;
+  }
+
+  static constexpr bool empty() {
+    return false;
+  }
+
+  // Elements access
+
+  constexpr reference operator()(size_t row, size_t col) {
+    assert(row < Rows && col < Cols);
+    return _data[row * Cols + col];
+  }
+
+  constexpr const_reference operator()(size_t row, size_t col) const {
+    assert(row < Rows && col < Cols);
+    return _data[row * Cols + col];
+  }
+
+  constexpr pointer data() {
+    return _data;
+  }
+
+  constexpr const_pointer data() const {
+    return _data;
+  }
+
+  // Views
+
+  operator view() {
+    return {_data, Rows, Cols};
+  }
+
+  operator const_view() const {
+    return {_data, Rows, Cols};
+  }
+
+  constexpr static_matrix<T, Cols, Rows> transposed() const {
+    static_matrix<T, Cols, Rows> res;
+#pragma GCC unroll 8
+    for (size_t row = 0; row < Rows; ++row) {
+#pragma GCC unroll 8
+      for (size_t col = 0; col < Cols; ++col) {
+        res(col, row) = (*this)(row, col);
+      }
+    }
+    return res;
+  }
+
+  // Comparison
+
+  friend constexpr bool operator==(const static_matrix& left, const static_matrix& right) {
+    return std::equal(left._data, left._data + Rows * Cols, right._data);
+  }
+
+  friend constexpr bool operator!=(const static_matrix& left, const static_matrix& right) {
+    return !(left == right);
+  }
+
+  // Arithmetic operations
+
+  constexpr static_matrix& operator+=(const static_matrix& other) {
+#pragma GCC unroll 64
+    for (size_t i = 0; i < Rows * Cols; ++i) {
+      _data[i] = _data[i] + other._data[i];
+    }
+    return *this;
+  }
+
+  constexpr static_matrix& operator-=(const static_matrix& other) {
+#pragma GCC unroll 64
+    for (size_t i = 0; i < Rows * Cols; ++i) {
+      _data[i] = _data[i] - other._data[i];
+    }
+    return *this;
+  }
+
+  constexpr static_matrix& operator*=(const_reference factor) {
+#pragma GCC unroll 64
+    for (size_t i = 0; i < Rows * Cols; ++i) {
+      _data[i] = _data[i] * factor;
+    }
+    return *this;
+  }
+
+  constexpr static_matrix& operator*=(const static_matrix& other)
+    requires (Rows == Cols)
+  {
+    return *this = *this * other;
+  }
+
+  // With a matrix, a view or an expression of the same size
+  template <matrix_expr::operand E>
+  static_matrix& operator+=(const E& e) {
+    assert(e.rows() == Rows && e.cols() == Cols);
+    matrix_expr::evaluate(matrix_expr::wrap(e), _data, Cols, matrix_expr::assign_op::add);
+    return *this;
+  }
+
+  template <matrix_expr::operand E>
+  static_matrix& operator-=(const E& e) {
+    assert(e.rows() == Rows && e.cols() == Cols);
+    matrix_expr::evaluate(matrix_expr::wrap(e), _data, Cols, matrix_expr::assign_op::subtract);
+    return *this;
+  }
+
+  friend constexpr static_matrix operator+(const static_matrix& left, const static_matrix& right) {
+    static_matrix res = left;
+    return res += right;
+  }
+
+  friend constexpr static_matrix operator-(const static_matrix& left, const static_matrix& right) {
+    static_matrix res = left;
+    return res -= right;
+  }
+
+  friend constexpr static_matrix operator*(const static_matrix& left, const_reference right) {
+    static_matrix res = left;
+    return res *= right;
+  }
+
+  friend constexpr static_matrix operator*(const_reference left, const static_matrix& right) {
+    return right * left;
+  }
+
+  // Row i of the product accumulates left(i, k) * row k of right, in order of k. The loops are
+  // unrolled completely up to 8 x 8 x 8.
+  template <size_t K>
+  friend constexpr static_matrix<T, Rows, K> operator*(const static_matrix& left,
+                                                       const static_matrix<T, Cols, K>& right) {
+    static_matrix<T, Rows, K> res;
+#pragma GCC unroll 8
+    for (size_t i = 0; i < Rows; ++i) {
+      T* out = res.row_begin(i);
+#pragma GCC unroll 8
+      for (size_t j = 0; j < K; ++j) {
+        out[j] = left(i, 0) * right(0, j);
+      }
+#pragma GCC unroll 8
+      for (size_t k = 1; k < Cols; ++k) {
+#pragma GCC unroll 8
+        for (size_t j = 0; j < K; ++j) {
+          out[j] = out[j] + left(i, k) * right(k, j);
+        }
+      }
+    }
+    return res;
+  }
+
+private:
+  T _data[Rows * Cols];
+};
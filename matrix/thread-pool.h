@@ -0,0 +1,206 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace matrix_parallel {
+// Fixed set of worker threads that run one indexed job at a time
+class thread_pool {
+public:
+  explicit thread_pool(size_t threads) : _workers(threads > 1 ? new std::thread[threads - 1] : nullptr),
+                                         _worker_count(threads > 1 ? threads - 1 : 0) {
+    for (size_t i = 0; i < _worker_count; ++i) {
+      _workers[i] = std::thread([this] { work(); });
+    }
+  }
+
+  thread_pool(const thread_pool& other) = delete;
+  thread_pool& operator=(const thread_pool& other) = delete;
+
+  ~thread_pool() {
+    {
+      std::lock_guard lock(_mutex);
+      _stop = true;
+    }
+    _wake.notify_all();
+    for (size_t i = 0; i < _worker_count; ++i) {
+      _workers[i].join();
+    }
+  }
+
+  // Number of threads taking part in run(), including the calling one
+  size_t size() const {
+    return _worker_count + 1;
+  }
+
+  // Calls task(i) for every i in [0, count) on the workers and the calling thread, returns once all
+  // calls have finished. Concurrent run() calls are serialized, a run() from inside a task is serial.
+  void run(size_t count, const std::function<void(size_t)>& task) {
+    if (count == 0) {
+      return;
+    }
+    if (inside_task()) {
+      for (size_t i = 0; i < count; ++i) {
+        task(i);
+      }
+      return;
+    }
+    std::lock_guard run_lock(_run_mutex);
+    std::unique_lock lock(_mutex);
+    _task = &task;
+    _count = count;
+    _next = 0;
+    ++_generation;
+    _wake.notify_all();
+    drain(lock);
+    _done.wait(lock, [this] { return _next == _count && _running == 0; });
+    _task = nullptr;
+  }
+
+private:
+  std::unique_ptr<std::thread[]> _workers;
+  size_t _worker_count;
+  std::mutex _run_mutex;
+  std::mutex _mutex;
+  std::condition_variable _wake;
+  std::condition_variable _done;
+  const std::function<void(size_t)>* _task = nullptr;
+  size_t _count = 0;
+  size_t _next = 0;
+  size_t _running = 0;
+  size_t _generation = 0;
+  bool _stop = false;
+
+  static bool& inside_task() {
+    thread_local bool inside = false;
+    return inside;
+  }
+
+  void work() {
+    size_t seen = 0;
+    std::unique_lock lock(_mutex);
+    while (true) {
+      _wake.wait(lock, [&] { return _stop || _generation != seen; });
+      if (_stop) {
+        return;
+      }
+      seen = _generation;
+      drain(lock);
+    }
+  }
+
+  void drain(std::unique_lock<std::mutex>& lock) {
+    while (_task && _next < _count) {
+      size_t i = _next++;
+      const std::function<void(size_t)>& task = *_task;
+      ++_running;
+      lock.unlock();
+      inside_task() = true;
+      task(i);
+      inside_task() = false;
+      lock.lock();
+      --_running;
+    }
+    if (_running == 0) {
+      _done.notify_all();
+    }
+  }
+};
+
+// Settings shared by all matrices. Changing them while a matrix operation runs is not allowed. The
+// numbers are atomic so that work below the threshold never takes the lock, which only guards the
+// lazily created pool.
+struct settings {
+  std::mutex mutex;
+  std::atomic<size_t> threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+  // operations (elements, or multiply-adds for a product) below which work stays on the calling thread
+  std::atomic<size_t> threshold = size_t(1) << 20;
+  std::unique_ptr<thread_pool> pool;
+};
+
+inline settings& global_settings() {
+  static settings s;
+  return s;
+}
+
+// 0 means one thread per core, 1 disables parallelism
+inline void set_threads(size_t threads) {
+  settings& s = global_settings();
+  std::lock_guard lock(s.mutex);
+  s.threads = threads == 0 ? std::max<size_t>(std::thread::hardware_concurrency(), 1) : threads;
+  s.pool.reset();
+}
+
+inline size_t threads() {
+  return global_settings().threads.load(std::memory_order_relaxed);
+}
+
+inline void set_threshold(size_t operations) {
+  global_settings().threshold.store(operations, std::memory_order_relaxed);
+}
+
+inline size_t threshold() {
+  return global_settings().threshold.load(std::memory_order_relaxed);
+}
+
+// Elements of T in a cache line, used as block alignment for elementwise work so that threads do
+// not share lines
+template <class T>
+inline constexpr size_t cache_line_elements = std::max<size_t>(64 / sizeof(T), 1);
+
+// Splits [0, count) into contiguous blocks whose bounds are multiples of align and calls f(first, last)
+// for each block on the shared pool. Work of fewer than threshold() operations runs as one block.
+// Which thread handles a block never affects the result as long as f writes disjoint data.
+template <class F>
+void for_each_block(size_t count, size_t operations, size_t align, F f) {
+  settings& s = global_settings();
+  size_t threads = s.threads.load(std::memory_order_relaxed);
+  if (threads <= 1 || operations < s.threshold.load(std::memory_order_relaxed) || count <= align) {
+    f(0, count);
+    return;
+  }
+  thread_pool* pool = nullptr;
+  {
+    std::lock_guard lock(s.mutex);
+    if (!s.pool) {
+      s.pool = std::make_unique<thread_pool>(threads);
+    }
+    pool = s.pool.get();
+  }
+  size_t blocks = std::min(pool->size(), (count + align - 1) / align);
+  size_t block = ((count + blocks - 1) / blocks + align - 1) / align * align;
+  pool->run((count + block - 1) / block, [&](size_t i) { f(i * block, std::min(count, (i + 1) * block)); });
+}
+
+// Calls f(row, col, count) for every piece of a row among the storage positions [first, last) of a
+// matrix with cols columns and row stride stride. The padding after each row is skipped.
+template <class F>
+void for_each_piece(size_t first, size_t last, size_t cols, size_t stride, F f) {
+  if (first >= last) {
+    return;
+  }
+  // one division, the following rows are stepped to
+  size_t row = first / stride;
+  size_t col = first % stride;
+  for (size_t start = row * stride; start < last; ++row, start += stride, col = 0) {
+    if (col < cols) {
+      f(row, col, std::min(last - start - col, cols - col));
+    }
+  }
+}
+
+// Splits the storage of a rows x cols matrix of T with row stride stride into blocks of whole cache
+// lines and calls f(row, col, count) for the pieces of rows in each block. Without padding this is a
+// flat split of the elements, so a single row or a thin matrix is spread over the threads too.
+template <class T, class F>
+void for_each_span(size_t rows, size_t cols, size_t stride, F f) {
+  for_each_block(rows * stride, rows * cols, cache_line_elements<T>,
+                 [&](size_t first, size_t last) { for_each_piece(first, last, cols, stride, f); });
+}
+} // namespace matrix_parallel